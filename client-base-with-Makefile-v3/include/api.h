@@ -1,6 +1,8 @@
 #ifndef API_H
 #define API_H
 
+#include <stddef.h>
+
 typedef struct {
   int width;
   int height;
@@ -8,16 +10,52 @@ typedef struct {
   int victory;
   int game_over;
   int accumulated_points;
+  int view_x;   // position of this width x height window inside the level (0, 0: whole board)
+  int view_y;
   char* data;
 } Board;
 
+#define PACMAN_TRANSPORT_FIFO 0
+#define PACMAN_TRANSPORT_SHM 1
+
+/// Transport asked for by the next pacman_connect (PACMAN_TRANSPORT_FIFO by default).
+/// With PACMAN_TRANSPORT_SHM the boards come through a shared memory segment when the
+/// server accepts it, and through the notification FIFO otherwise.
+void pacman_set_transport(int transport);
+
+/// Transport actually in use by the current session.
+int pacman_transport(void);
+
+/// Largest window the client can show, asked for by the next pacman_connect: on larger
+/// levels the server only sends the width x height cells around the pacman.
+/// 0, 0 (the default) asks for the whole board.
+void pacman_set_viewport(int width, int height);
+
 int pacman_connect(char const *req_pipe_path, char const *notif_pipe_path, char const *server_pipe_path);
 
+/// Watches the active game of player_id instead of playing: the boards arrive through
+/// notif_pipe_path and are read with receive_board_update as usual; pacman_play does nothing.
+/// @return 0 on success, 1 if there is no such game, it has no room for spectators or the
+/// server did not answer.
+int pacman_spectate(char const *notif_pipe_path, char const *server_pipe_path, char const *player_id);
+
 void pacman_play(char command);
 
 /// @return 0 if the disconnection was successful, 1 otherwise.
 int pacman_disconnect();
 
+/// Receives the next board into a newly allocated board.data, which the caller frees.
+/// @return a Board with data == NULL if the connection ended.
 Board receive_board_update(void);
 
+/// Allocation-free variant: receives into board->data, owned by the caller, which only
+/// grows (realloc) when a board larger than *capacity arrives. Start with data == NULL
+/// and *capacity == 0, reuse both for every frame and free(board->data) at the end.
+/// @return 0 on success, -1 if the connection ended (board->data is kept either way).
+int receive_board_update_into(Board *board, size_t *capacity);
+
+/// Number of heap allocations made by this api so far; stays constant during
+/// steady-state play with receive_board_update_into.
+unsigned long long api_allocation_count(void);
+
 #endif
\ No newline at end of file
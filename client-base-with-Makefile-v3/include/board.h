@@ -5,7 +5,7 @@
 #define MAX_LEVELS 20
 #define MAX_FILENAME 256
 #define MAX_GHOSTS 25
-#include <pthread.h>
+#define MAX_TICK_MOVES 8
 
 typedef enum {
     REACHED_PORTAL = 1,
@@ -41,16 +41,13 @@ typedef struct {
     int charged;
 } ghost_t;
 
-typedef struct {
-    char content; // stuff like 'P' for pacman 'M' for monster and 'W' for wall
-    int has_dot; // whether there is a dot in this position or not
-    int has_portal; // whether there is a portal in this position or not
-    pthread_mutex_t lock;
-} board_pos_t;
-
 typedef struct {
     int width, height; //dimensions of the board
-    board_pos_t* board; //actual board, most likely a row-major matrix
+    // Row-major planes, one entry per cell. Only the session's tick thread mutates them, so no per-cell locks
+    char* content; // stuff like 'P' for pacman 'M' for monster and 'W' for wall
+    unsigned char* dots; // bitplane: whether there is a dot in each position or not
+    unsigned char* portals; // bitplane: whether there is a portal in each position or not
+    int* occupant; // entity on each cell: 0 = none, g + 1 = ghost g, -(p + 1) = pacman p
     int n_pacmans; //number of pacmans in the board
     pacman_t* pacmans; // array containing every pacman in the board to iterate through when processing
     int n_ghosts; //number of ghosts in the board
@@ -59,10 +56,28 @@ typedef struct {
     char pacman_file[256]; // file with pacman movements
     char ghosts_files[MAX_GHOSTS][256]; // files with monster movements
     int tempo; // Duracao de cada jogada???
-    pthread_rwlock_t state_lock;
     char player_id[50];
+    unsigned int rng_state; // rand_r state for 'R' moves; seeding it makes a game reproducible
 } board_t;
 
+// Bytes needed for a bitplane of n cells
+#define BITPLANE_BYTES(n) (((n) + 7) / 8)
+
+static inline int bitplane_get(const unsigned char* plane, int index) {
+    return (plane[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline void bitplane_set(unsigned char* plane, int index, int value) {
+    if (value) plane[index >> 3] |= (unsigned char)(1u << (index & 7));
+    else plane[index >> 3] &= (unsigned char)~(1u << (index & 7));
+}
+
+// Player commands to apply in a single tick, in arrival order
+typedef struct {
+    int n_moves;
+    char moves[MAX_TICK_MOVES];
+} board_inputs_t;
+
 /*Move pacman/monster in a certain direction on the board must check for boundaries, walls and other monsters
 Maybe do 1 function for pacman and 1 for monsters if required
 Maybe do 1 function for each direction
@@ -70,6 +85,14 @@ Maybe do 1 function for each direction
 int move_pacman(board_t* board, int pacman_index, command_t* command);
 int move_ghost(board_t* board, int ghost_index, command_t* command);
 
+/*Slides a charged ghost in direction until it hits a wall, another ghost or a pacman (which dies)*/
+int move_ghost_charged(board_t* board, int ghost_index, char direction);
+
+/*Advances the board by one tick: the pacman applies the inputs, then every ghost
+makes its next scripted move in index order. Single-threaded, takes no locks.
+Returns REACHED_PORTAL, DEAD_PACMAN or VALID_MOVE*/
+int board_step(board_t* board, const board_inputs_t* inputs);
+
 /*Remove an object (Pacman)*/
 void kill_pacman(board_t* board, int pacman_index);
 
@@ -87,6 +110,14 @@ int load_level(board_t* board, char* filename, char* dirname, int accumulated_po
 // Unloads levels loaded by load_level
 void unload_level(board_t * board);
 
+/*Renders the board as the client sees it into output (width * height chars, no terminator).
+O(width * height), uses the occupancy index instead of scanning the ghosts*/
+void render_board(board_t* board, char* output);
+
+/*Same as render_board for the width x height window with its top-left corner at (x, y),
+which must lie inside the board. O(width * height) whatever the size of the board*/
+void render_board_window(board_t* board, int x, int y, int width, int height, char* output);
+
 void print_board(board_t* board);
 
 #endif
@@ -1,15 +1,54 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 // DEBUG FILE
-#include <stdio.h>  
+#include <stdio.h>
+
+// Log levels, most severe first. A message is kept if its level is <= the active level.
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+// Messages above this level are removed by the compiler (build with -DLOG_COMPILE_LEVEL=...)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Runtime level, LOG_LEVEL_DEBUG by default. open_debug_file reads PACMAN_LOG_LEVEL
+// (error, warn, info, debug or 0-3) from the environment.
+extern int log_runtime_level;
 
 extern FILE *debugfile;
+
+// Opens the log file and starts the background writer
 void open_debug_file(char *filename);
 
+// Writes everything still buffered and closes the file
 void close_debug_file();
 
-void debug(const char * format, ...);
+void log_set_level(int level);
+
+/* Each thread formats into its own lock-free ring; a background thread drains the rings
+(ordered by timestamp) into debugfile. Never blocks: when a ring is full the message is
+dropped and counted. Disabled levels skip the call, so their arguments are not even evaluated. */
+void log_write(int level, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+#define log_at(level, ...) \
+    do { \
+        if ((level) <= LOG_COMPILE_LEVEL && (level) <= log_runtime_level) log_write((level), __VA_ARGS__); \
+    } while (0)
+
+#define log_error(...) log_at(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_info(...) log_at(LOG_LEVEL_INFO, __VA_ARGS__)
+#define debug(...) log_at(LOG_LEVEL_DEBUG, __VA_ARGS__)
 
 void sleep_ms(int milliseconds);
 
-#endif
\ No newline at end of file
+// Monotonic clock in milliseconds, for tick deadlines
+long long current_time_ms(void);
+
+// Same clock in nanoseconds, for measuring short intervals
+long long current_time_ns(void);
+
+#endif
@@ -17,7 +17,10 @@ Potential Structures for ncurses
 /*Initialize everything ncurses requires*/
 int terminal_init();
 
-void draw_board_client(Board board);
+/*Draw a received board, touching only the cells that differ from the previous one
+(the whole screen is redrawn when the board size changes). Returns 0 if nothing changed,
+in which case there is no need to refresh the screen*/
+int draw_board_client(Board board);
 
 char* get_board_displayed(board_t* board);
 
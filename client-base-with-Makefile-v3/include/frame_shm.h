@@ -0,0 +1,62 @@
+#ifndef FRAME_SHM_H
+#define FRAME_SHM_H
+
+#include "protocol.h"
+
+// Transporte de tabuleiros por memória partilhada (CLIENT_CAP_SHM): um segmento POSIX por
+// sessão com dois buffers de tabuleiro, cada um com o seu seqlock. O servidor escreve cada
+// tabuleiro uma só vez, diretamente no buffer que não tem o mais recente; o cliente copia o
+// mais recente sem passar pelo kernel e dorme num futex enquanto não há tabuleiro novo.
+// Enquanto o cliente copia um buffer o servidor está a escrever no outro: só repete a cópia
+// se ficar dois tabuleiros inteiros para trás.
+// A cópia para o buffer do cliente mantém-se (o Board é dele e sobrevive ao tick seguinte);
+// ler no próprio segmento obrigava o cliente a reservar o buffer enquanto o desenha.
+// Só interessa o tabuleiro mais recente: um cliente lento salta tabuleiros, mas nunca o último.
+
+typedef struct {
+    unsigned int seq;           // seqlock: ímpar durante uma escrita
+    frame_header_t header;      // payload_size = width * height
+} frame_shm_slot_t;
+
+typedef struct {
+    unsigned int published;     // tabuleiros publicados; o mais recente está em slots[published % 2]
+    unsigned int events;        // palavra do futex: muda a cada tabuleiro publicado e no fecho
+    unsigned int waiters;       // o cliente está (ou vai ficar) à espera no futex
+    unsigned int closed;        // a sessão terminou, não vêm mais tabuleiros
+    int capacity;               // células reservadas por buffer (maior nível da cache)
+    frame_shm_slot_t slots[2];
+    char cells[];               // células do buffer 0 e, a seguir, as do buffer 1
+} frame_shm_t;
+
+// Nome do segmento de uma sessão, derivado do pipe de notificações
+#define FRAME_SHM_NAME_LENGTH (MAX_PIPE_PATH_LENGTH + 16)
+void frame_shm_name(const char* notif_path, char* name);
+
+// Servidor: cria (substituindo um segmento antigo com o mesmo nome) e mapeia. NULL se falhar.
+// O segmento fica 0600: o cliente tem de correr com o mesmo utilizador que o servidor.
+frame_shm_t* frame_shm_create(const char* name, int capacity);
+
+// Cliente: mapeia o segmento criado pelo servidor e apaga o nome. NULL se falhar.
+frame_shm_t* frame_shm_open(const char* name);
+
+size_t frame_shm_size(const frame_shm_t* shm);
+void frame_shm_unmap(frame_shm_t* shm);
+
+// Células do buffer slot (0 ou 1)
+char* frame_shm_cells(frame_shm_t* shm, int slot);
+
+// Escritor: begin devolve o buffer a escrever (o que não tem o tabuleiro mais recente); entre
+// begin e end o tabuleiro é escrito em shm->slots[slot].header e frame_shm_cells(shm, slot).
+// O buffer só volta a ser escrito dois tabuleiros depois.
+int frame_shm_write_begin(frame_shm_t* shm);
+void frame_shm_write_end(frame_shm_t* shm, int slot);
+
+// Fim da sessão: acorda o cliente, que deixa de esperar por tabuleiros
+void frame_shm_close(frame_shm_t* shm);
+
+// Leitor: espera até haver um tabuleiro publicado depois de *seq (no máximo timeout_ms) e copia
+// o mais recente para header e cells (com pelo menos shm->capacity bytes), atualizando *seq.
+// Devolve 1 se leu um tabuleiro, 0 se o tempo acabou e -1 se a sessão terminou.
+int frame_shm_read(frame_shm_t* shm, unsigned int* seq, frame_header_t* header, char* cells, int timeout_ms);
+
+#endif
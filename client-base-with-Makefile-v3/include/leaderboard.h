@@ -0,0 +1,33 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+// Classificação em tempo real dos jogos ativos.
+// As sessões atualizam a sua entrada sempre que os pontos mudam e a lista mantém-se ordenada
+// de forma incremental. A leitura do top K é O(K) e não usa locks: um seqlock deteta
+// escritas concorrentes e o leitor simplesmente repete a cópia.
+
+#define LEADERBOARD_ID_SIZE 50
+#define LEADERBOARD_DEFAULT_K 5
+#define LEADERBOARD_MAX_K 1000 // limite da opção -k do servidor
+
+typedef struct {
+    int slot;
+    int points;
+    char player_id[LEADERBOARD_ID_SIZE];
+} leaderboard_entry_t;
+
+// capacity: número máximo de sessões em simultâneo (slots 0 .. capacity - 1)
+int leaderboard_init(int capacity);
+
+// Cria ou atualiza a entrada do slot e repõe a ordem (só desloca a entrada o necessário)
+void leaderboard_update(int slot, const char* player_id, int points);
+
+// Retira a entrada do slot; tem de ser chamada antes de o slot ser reutilizado
+void leaderboard_remove(int slot);
+
+// Copia para out as até k melhores entradas, por pontos decrescentes. Devolve quantas copiou.
+int leaderboard_top(leaderboard_entry_t* out, int k);
+
+void leaderboard_destroy(void);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef LEVEL_BINARY_H
+#define LEVEL_BINARY_H
+
+#include <stdint.h>
+#include "board.h"
+
+/* Precompiled level format (.lvlb), produced by levelc from the .lvl/.p/.m text files.
+Layout (native byte order, no padding):
+    levelb_header_t
+    levelb_entity_t[n_pacmans]   pacman spawns
+    levelb_entity_t[n_ghosts]    ghost spawns and move scripts
+    walls, dots, portals         bitplanes of BITPLANE_BYTES(width * height) bytes each
+Loading is an mmap, a few memcpys and one pass to expand the walls into the content plane.
+A .lvlb older than its .lvl or any of the .p/.m files it was compiled from is stale and
+is not loaded, so edited levels fall back to the text parser until levelc runs again*/
+
+#define LEVELB_MAGIC "LVLB"
+#define LEVELB_VERSION 2
+#define LEVELB_EXTENSION ".lvlb"
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t tempo;
+    int32_t n_pacmans;
+    int32_t n_ghosts;
+    uint32_t entities_offset;
+    uint32_t walls_offset;
+    uint32_t dots_offset;
+    uint32_t portals_offset;
+    uint32_t file_size;
+} levelb_header_t;
+
+typedef struct __attribute__((packed)) {
+    char command;
+    int32_t turns;
+} levelb_move_t;
+
+typedef struct __attribute__((packed)) {
+    int32_t pos_x;
+    int32_t pos_y;
+    int32_t passo;
+    int32_t n_moves;
+    levelb_move_t moves[MAX_MOVES];
+    char source[MAX_FILENAME];  // .p/.m file name, relative to the level directory ("" if none)
+} levelb_entity_t;
+
+/*Writes an already loaded board (as left by read_level/read_pacman/read_ghosts) to path*/
+int write_level_binary(board_t* board, const char* path);
+
+/*Fills board from a .lvlb file. Returns -1 if it does not exist, is not a valid .lvlb
+or is stale (older than one of its sources)*/
+int read_level_binary(board_t* board, const char* path);
+
+#endif
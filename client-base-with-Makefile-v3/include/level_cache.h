@@ -0,0 +1,27 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include "board.h"
+
+// Cache de níveis partilhada por todas as sessões do servidor.
+// Os níveis são lidos e interpretados uma única vez; cada sessão recebe uma cópia
+// independente, pelo que as mudanças de nível e as novas ligações não tocam no disco.
+
+// Lê todos os .lvl de dirname (pela mesma ordem do scandir/alphasort). Devolve o nº de níveis ou -1.
+int level_cache_init(char* dirname);
+
+int level_cache_count(void);
+
+// Nome do nível index (ficheiro sem extensão), ou NULL se não existir
+const char* level_cache_name(int index);
+
+// Maior número de células de um nível da cache (para dimensionar buffers por sessão)
+int level_cache_max_cells(void);
+
+// Preenche board com uma cópia do nível index e a pontuação inicial points.
+// Mantém o player_id e o estado do gerador aleatório de board. Liberta-se com unload_level.
+int level_cache_instantiate(int index, board_t* board, int points);
+
+void level_cache_destroy(void);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+// Registo de métricas do servidor, atualizado sem locks pelas sessões e pelo main.
+// metrics_write produz um snapshot no formato de texto do Prometheus
+// (linhas "nome{etiquetas} valor"), pronto a ser lido por um scraper.
+
+typedef enum {
+    METRIC_TICK_DURATION,   // tick completo de uma sessão
+    METRIC_FRAME_ENCODE,    // render_board + codificação do delta
+    METRIC_NOTIF_WRITE,     // writev do tabuleiro no pipe de notificações
+    METRIC_N_HISTOGRAMS
+} metric_histogram_t;
+
+typedef enum {
+    METRIC_REQUEST_QUEUE_DEPTH, // pedidos de ligação à espera no request_buffer
+    METRIC_ACTIVE_SESSIONS,
+    METRIC_N_GAUGES
+} metric_gauge_t;
+
+// Contadores de uma sessão; a sessão é dona da struct e regista-a enquanto está ativa
+typedef struct metrics_session {
+    int slot;
+    char player_id[50];
+    unsigned long long frames;
+    unsigned long long bytes;
+    unsigned long long commands;
+} metrics_session_t;
+
+// max_sessions: número de slots de sessão (max_games)
+int metrics_init(int max_sessions);
+
+void metrics_observe_ns(metric_histogram_t histogram, long long ns);
+void metrics_gauge_set(metric_gauge_t gauge, long long value);
+
+void metrics_session_register(metrics_session_t* session);
+void metrics_session_unregister(metrics_session_t* session);
+
+// Atualizam a sessão e os totais do servidor
+void metrics_count_frame(metrics_session_t* session, unsigned long long bytes);
+void metrics_count_commands(metrics_session_t* session, int n);
+// Só bytes: tabuleiros já contados, copiados para os espectadores da sessão
+void metrics_count_bytes(metrics_session_t* session, unsigned long long bytes);
+
+// Comandos que a política de entrada deitou fora (fila cheia ou substituídos)
+void metrics_count_discarded(int n);
+
+void metrics_write(FILE* out);
+
+void metrics_destroy(void);
+
+#endif
@@ -3,7 +3,27 @@
 
 #include "dirent.h"
 #include "board.h"
+#include <stddef.h>
 #define MAX_COMMAND_LENGTH 256
+#define LINE_READER_BUFFER_SIZE 65536
+
+// Buffered line reader: one read() per LINE_READER_BUFFER_SIZE bytes instead of one per char.
+// Lines have no length limit (the buffer grows to fit them)
+typedef struct {
+    int fd;
+    char* buffer;
+    size_t capacity;
+    size_t start; // first unconsumed byte
+    size_t end;   // end of valid data
+    int eof;
+} line_reader_t;
+
+int line_reader_open(line_reader_t* reader, int fd);
+/* Points *line at the next line (no '\n' or '\r', NUL terminated, writable),
+valid until the next call. Returns 1 if there is a line, 0 at end of file, -1 on error*/
+int line_reader_next(line_reader_t* reader, char** line);
+// Frees the reader's buffer (the fd stays open)
+void line_reader_close(line_reader_t* reader);
 
 int read_line(int fd, char* buffer);
 int read_level(board_t* board, char* filename, char* dirname);
@@ -3,11 +3,78 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <stddef.h>
+
 enum {
   OP_CODE_CONNECT = 1,
   OP_CODE_DISCONNECT = 2,
   OP_CODE_PLAY = 3,
   OP_CODE_BOARD = 4,
+  OP_CODE_BOARD_DELTA = 5,
+  OP_CODE_CONNECT_EXT = 6,
+  OP_CODE_SPECTATE = 7,
+  OP_CODE_BOARD_RLE = 8,
 };
 
-#endif
\ No newline at end of file
+// Pedido de ligação: (char) OP_CODE_CONNECT | (char[40]) req_pipe | (char[40]) notif_pipe
+#define CONNECT_REQUEST_SIZE (1 + 2 * MAX_PIPE_PATH_LENGTH)
+
+// OP_CODE_CONNECT_EXT: igual ao anterior seguido de (char) caps.
+// Clientes antigos continuam a usar OP_CODE_CONNECT e recebem sempre tabuleiros completos.
+#define CONNECT_EXT_REQUEST_SIZE (CONNECT_REQUEST_SIZE + 1)
+
+// Capacidades anunciadas pelo cliente (bitmask no campo caps)
+#define CLIENT_CAP_DELTA 0x01
+#define CLIENT_CAP_SHM 0x02     // tabuleiros por memória partilhada (frame_shm.h) em vez do FIFO
+#define CLIENT_CAP_VIEWPORT 0x04 // só uma janela do tabuleiro à volta do pacman
+#define CLIENT_CAP_RLE 0x08     // tabuleiros completos comprimidos (OP_CODE_BOARD_RLE)
+
+// Com CLIENT_CAP_VIEWPORT o pedido OP_CODE_CONNECT_EXT leva ainda (int) view_width | (int) view_height:
+// o tamanho máximo da janela que o cliente consegue mostrar
+#define CONNECT_VIEWPORT_REQUEST_SIZE (CONNECT_EXT_REQUEST_SIZE + 2 * (int)sizeof(int))
+
+// Resposta ao pedido de ligação: (char) OP_CODE_CONNECT | (char) resultado (0 = ok)
+// A OP_CODE_CONNECT_EXT segue-se (char) caps aceites pelo servidor (subconjunto das pedidas).
+// Com CLIENT_CAP_SHM aceite, os tabuleiros deixam de vir pelo pipe de notificações, que
+// continua aberto como canal de controlo: fecha-se quando a sessão termina.
+#define CONNECT_RESPONSE_SIZE 2
+#define CONNECT_EXT_RESPONSE_SIZE 3
+
+// Pedido para assistir a um jogo ativo: (char) OP_CODE_SPECTATE | (char[40]) notif_pipe | (char[40]) player_id
+// O cliente abre o seu pipe para leitura (O_NONBLOCK) antes de enviar o pedido: o servidor nunca
+// espera por espectadores. Resposta no pipe: (char) OP_CODE_SPECTATE | (char) resultado (0 = ok);
+// seguem-se os mesmos bytes que o jogador recebe (formato de OP_CODE_CONNECT_EXT), pelo que o
+// espectador tem de aceitar OP_CODE_BOARD, OP_CODE_BOARD_DELTA e OP_CODE_BOARD_RLE.
+// Um espectador lento perde tabuleiros (retoma no keyframe seguinte) em vez de atrasar o jogo.
+#define SPECTATE_REQUEST_SIZE (1 + 2 * MAX_PIPE_PATH_LENGTH)
+#define MAX_SPECTATORS 8
+
+// Cabeçalho de todas as mensagens de tabuleiro, enviado de uma só vez junto com o payload.
+// Os primeiros FRAME_HEADER_LEGACY_SIZE bytes são o formato original de OP_CODE_BOARD:
+// (char) op | (int) width | (int) height | (int) tempo | (int) victory | (int) game_over | (int) points
+// Os campos seguintes só são enviados a clientes OP_CODE_CONNECT_EXT: payload_size dá a todas
+// as mensagens de tabuleiro um tamanho explícito e view_x/view_y dizem onde está a janela
+// enviada (width x height células) dentro do tabuleiro; 0, 0 quando vai o tabuleiro inteiro.
+typedef struct __attribute__((packed)) {
+  char op_code;
+  int width;
+  int height;
+  int tempo;
+  int victory;
+  int game_over;
+  int points;
+  int payload_size;
+  int view_x;
+  int view_y;
+} frame_header_t;
+
+#define FRAME_HEADER_LEGACY_SIZE offsetof(frame_header_t, payload_size)
+
+// Payload de OP_CODE_BOARD: width * height células (as da janela, com CLIENT_CAP_VIEWPORT).
+// Payload de OP_CODE_BOARD_DELTA: (int) n_runs | n_runs x [(int) index | (int) len | (char[len]) células novas]
+// Só é válido sobre o último tabuleiro recebido com as mesmas dimensões (índices relativos à janela).
+// Payload de OP_CODE_BOARD_RLE: as width * height células comprimidas (formato em rle.h).
+// Só é enviado quando fica mais pequeno do que o tabuleiro sem compressão.
+#define DELTA_KEYFRAME_INTERVAL 32
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <sys/types.h>
+
+// Reactor de I/O: uma thread com epoll lê todos os pipes de pedidos registados,
+// em modo não bloqueante, e entrega os bytes ao dono de cada pipe.
+
+typedef struct reactor_handler {
+    int fd;
+    // Chamado na thread do reactor com tudo o que foi lido de uma vez.
+    // len == 0 indica que o cliente fechou o pipe (não há mais chamadas depois disso).
+    void (*on_data)(struct reactor_handler* handler, const char* buf, ssize_t len);
+    int closed;     // uso interno do reactor
+    int removed;    // uso interno do reactor
+    struct reactor_handler* next_removal;
+} reactor_handler_t;
+
+int reactor_start(void);
+
+// Passa handler->fd para não bloqueante e começa a vigiá-lo
+int reactor_add(reactor_handler_t* handler);
+
+// Deixa de vigiar o handler. Quando regressa, on_data já não está nem volta a ser chamado,
+// pelo que o dono pode fechar o fd e libertar a memória.
+void reactor_remove(reactor_handler_t* handler);
+
+void reactor_stop(void);
+
+#endif
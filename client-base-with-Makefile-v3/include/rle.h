@@ -0,0 +1,20 @@
+#ifndef RLE_H
+#define RLE_H
+
+// Compressão run-length das células de um tabuleiro (payload de OP_CODE_BOARD_RLE).
+// Os tabuleiros são quase só sequências de '#', '.' e ' ', que ficam com 2 bytes cada.
+// Formato: uma sequência de blocos, cada um começado por um byte de controlo c:
+//   c < 128:  seguem-se c + 1 células copiadas tal como estão
+//   c >= 128: a célula seguinte repete-se c - 125 vezes (3 a 130)
+#define RLE_MAX_LITERAL 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN 130
+
+// Comprime size células para out. Devolve o tamanho comprimido, ou -1 se não couber em
+// out_cap bytes (nesse caso compensa enviar o tabuleiro sem compressão). Não aloca memória.
+int rle_encode(const char* cells, int size, char* out, int out_cap);
+
+// Descomprime para exatamente size células. Devolve -1 se os dados estão mal formados.
+int rle_decode(const char* in, int in_size, char* cells, int size);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Scheduler M:N partilhado por todas as sessões.
+// Uma roda temporal (timer wheel) guarda as tarefas até ao seu deadline; quando este chega
+// a tarefa passa para a fila de um dos workers, que podem roubar trabalho uns aos outros.
+
+#define WHEEL_SLOTS 512         // cada slot cobre WHEEL_RESOLUTION_MS
+#define WHEEL_RESOLUTION_MS 1
+
+typedef struct sched_task {
+    // Executa um passo da tarefa. Para voltar a correr, a própria tarefa chama scheduler_schedule.
+    void (*run)(struct sched_task* task);
+    long long deadline_ms;
+    struct sched_task* next;    // uso interno do scheduler
+} sched_task_t;
+
+// Tempo ocupado de um worker desde scheduler_start
+typedef struct {
+    long long busy_ns;
+    long long tasks_run;
+} sched_worker_stats_t;
+
+// Lança a thread da roda e n_workers workers (<= 0 usa o número de cores)
+int scheduler_start(int n_workers);
+
+// Agenda task para correr a partir de deadline_ms (relógio de current_time_ms)
+void scheduler_schedule(sched_task_t* task, long long deadline_ms);
+
+// Copia as estatísticas de até max workers para out. Devolve o número de workers.
+int scheduler_stats(sched_worker_stats_t* out, int max);
+
+// Pára todas as threads; tarefas ainda agendadas não voltam a correr
+void scheduler_stop(void);
+
+#endif
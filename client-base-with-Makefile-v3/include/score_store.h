@@ -0,0 +1,45 @@
+#ifndef SCORE_STORE_H
+#define SCORE_STORE_H
+
+#include <stdint.h>
+
+// Recordes de sempre, por jogador e por nível, guardados entre execuções do servidor.
+// Cada pontuação é acrescentada a um log binário (só append). Um índice mapeado em memória
+// (tabela de hash com o máximo de cada par jogador/nível) evita reler o log no arranque.
+// Quem regista só põe a pontuação numa fila; uma thread de fundo escreve o log, atualiza o
+// índice e compacta o log quando este fica grande.
+
+#define SCORE_ID_SIZE 50
+#define SCORE_LEVEL_SIZE 32
+#define SCORE_LEVEL_TOTAL ""    // "nível" das pontuações de uma sessão inteira
+
+#define SCORE_LOG_FILE "server_scores.log"
+#define SCORE_INDEX_FILE "server_scores.idx"
+
+// Registo do log (formato em disco)
+typedef struct __attribute__((packed)) {
+    char player_id[SCORE_ID_SIZE];
+    char level[SCORE_LEVEL_SIZE];
+    int32_t points;
+    int64_t timestamp;  // segundos desde a epoch
+} score_record_t;
+
+typedef struct {
+    char player_id[SCORE_ID_SIZE];
+    char level[SCORE_LEVEL_SIZE];
+    int points;
+} score_entry_t;
+
+// Abre (ou cria) o log e o índice e lança a thread de fundo
+int score_store_open(const char* log_path, const char* index_path);
+
+// Regista uma pontuação. Nunca espera pelo disco; se a fila estiver cheia a pontuação perde-se.
+void score_store_record(const char* player_id, const char* level, int points);
+
+// Melhores k recordes de um nível (SCORE_LEVEL_TOTAL para sessões completas), por pontos decrescentes
+int score_store_top(const char* level, score_entry_t* out, int k);
+
+// Escreve o que ainda está na fila e fecha os ficheiros
+void score_store_close(void);
+
+#endif
@@ -3,7 +3,50 @@
 
 #include "board.h"
 
-// active_game_slot: ponteiro para o slot no array global do main.c
-void start_session(char* levels_dir, char* req_path, char* notif_path, board_t** active_game_slot);
+// Opções negociadas no pedido de ligação
+typedef struct {
+    int extended;       // ligou com OP_CODE_CONNECT_EXT (mensagens de tabuleiro com payload_size)
+    unsigned char caps; // CLIENT_CAP_*, 0 para clientes antigos
+    int view_width;     // com CLIENT_CAP_VIEWPORT: tamanho máximo da janela enviada
+    int view_height;
+} session_options_t;
+
+// Como os comandos recebidos entre dois ticks são aplicados no tick seguinte
+typedef enum {
+    INPUT_POLICY_PER_TICK,  // até limit comandos por tick, por ordem; os restantes são descartados
+    INPUT_POLICY_LAST_WINS, // só o comando mais recente; os anteriores são descartados
+    INPUT_POLICY_FIFO,      // um comando por tick, por ordem; no máximo limit à espera
+} input_policy_mode_t;
+
+typedef struct {
+    input_policy_mode_t mode;
+    int limit;
+} input_policy_t;
+
+// Fila de entrada de cada sessão (potência de 2): limite máximo de comandos à espera
+#define INPUT_QUEUE_SIZE 64
+
+// Lê "last", "fifo:<max_espera>" ou "tick:<por_tick>". Devolve -1 se a especificação é inválida.
+int input_policy_parse(const char* spec, input_policy_t* policy);
+
+// Política de todas as sessões; chamar antes de iniciar a primeira.
+// Por omissão "tick:MAX_TICK_MOVES", o comportamento de sempre.
+void session_set_input_policy(const input_policy_t* policy);
+
+typedef struct session session_t;
+
+// Agenda a sessão no scheduler, que faz o handshake com o cliente e corre os ticks; não espera
+// pelo cliente nem pelo fim do jogo. Os níveis vêm da level_cache, que tem de estar inicializada.
+// slot: índice da sessão no servidor, devolvido em on_end quando a sessão termina e se liberta
+// (também se o cliente não abrir o pipe de notificações a tempo)
+// O jogo aparece na leaderboard com este slot enquanto estiver ativo
+// Devolve -1 se a ligação falhou logo (on_end não é chamado nesse caso).
+int start_session(char* req_path, char* notif_path, const session_options_t* opts,
+                  int slot, void (*on_end)(int slot));
+
+
+// Junta um espectador (pipe notif_path, já aberto para leitura pelo cliente) ao jogo ativo de
+// player_id e responde-lhe no pipe. Não bloqueia. Devolve -1 se o jogo não existe ou está cheio.
+int session_add_spectator(const char* player_id, const char* notif_path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,393 @@
+// Microbenchmarks do motor do jogo: movimentos, render, compressão dos tabuleiros, carregamento
+// de níveis e leitura de linhas.
+// Gera níveis sintéticos N x N (parede à volta, pontos no interior, pacman em (1,1) e fantasmas
+// em linhas alternadas) numa diretoria temporária.
+// Saída em CSV (ou JSON com -j): benchmark,size,ghosts,ns_per_op,allocs_per_op,compression_ratio
+// (compression_ratio = tamanho do tabuleiro / tamanho comprimido, só nas linhas rle_*)
+// Com -c baseline.csv acrescenta o valor da baseline e a variação em percentagem.
+// As alocações contam malloc/calloc/realloc (ligado com -Wl,--wrap); as internas da libc não contam.
+// Uso: bench_engine [-j] [-c baseline.csv] [-s 20,50,...] [-g 1,8,...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "board.h"
+#include "parser.h"
+#include "level_binary.h"
+#include "display.h"
+#include "rle.h"
+#include "debug.h"
+
+#define MIN_BENCH_NS 100000000LL // cada medição corre pelo menos 0.1 s
+#define MIN_ITERATIONS 3
+#define MAX_BENCH_SIZES 16
+#define MAX_BASELINE_ROWS 1024
+#define BENCH_NAME_SIZE 32
+
+// --- Contagem de alocações ---
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static unsigned long long alloc_count = 0;
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+// --- Níveis sintéticos ---
+
+typedef struct {
+    int size;
+    int n_ghosts;
+    board_t board;      // carregado uma vez por (size, n_ghosts) para os benchmarks de movimento
+    char* frame;
+    char* rle_buf;      // tabuleiro comprimido (rle_len bytes)
+    int rle_len;
+    double compression_ratio; // 0 nas linhas que não são de compressão
+    long long op;       // número da operação, para alternar direções
+} bench_ctx_t;
+
+static char* bench_dir;
+static char level_path[MAX_FILENAME];
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Fantasmas de 2 em 2 colunas nas linhas pares a partir da 2, para se moverem sem colidir
+static void ghost_position(int n, int g, int* x, int* y) {
+    int per_row = (n - 2) / 2;
+    *x = 1 + 2 * (g % per_row);
+    *y = 2 + 2 * (g / per_row);
+}
+
+static int write_level(int n, int n_ghosts) {
+    char path[MAX_FILENAME * 2];
+
+    FILE* f = fopen(level_path, "w");
+    if (!f) return -1;
+    fprintf(f, "DIM %d %d\nTEMPO 200\nPAC bench.p\nMON", n, n);
+    for (int g = 0; g < n_ghosts; g++) fprintf(f, " g%d.m", g);
+    fprintf(f, "\n");
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            char c = 'o';
+            if (y == 0 || x == 0 || y == n - 1 || x == n - 1) c = 'X';
+            else if (y == n - 2 && x == n - 2) c = '@';
+            fputc(c, f);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s/bench.p", bench_dir);
+    f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "PASSO 0\nPOS 1 1\nD\n");
+    fclose(f);
+
+    for (int g = 0; g < n_ghosts; g++) {
+        int x, y;
+        ghost_position(n, g, &x, &y);
+        snprintf(path, sizeof(path), "%s/g%d.m", bench_dir, g);
+        f = fopen(path, "w");
+        if (!f) return -1;
+        fprintf(f, "PASSO 0\nPOS %d %d\nD\nA\n", x, y);
+        fclose(f);
+    }
+    return 0;
+}
+
+static void remove_level_files(int n_ghosts) {
+    char path[MAX_FILENAME * 2];
+    unlink(level_path);
+    snprintf(path, sizeof(path), "%s/bench.p", bench_dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/bench.lvlb", bench_dir);
+    unlink(path);
+    for (int g = 0; g < n_ghosts; g++) {
+        snprintf(path, sizeof(path), "%s/g%d.m", bench_dir, g);
+        unlink(path);
+    }
+}
+
+// --- Operações medidas ---
+
+static void op_move_pacman(bench_ctx_t* ctx) {
+    command_t cmd = {(ctx->op & 1) ? 'A' : 'D', 1, 1};
+    move_pacman(&ctx->board, 0, &cmd);
+}
+
+// Cada passagem move todos os fantasmas na mesma direção; a seguinte volta para trás
+static void op_move_ghost(bench_ctx_t* ctx) {
+    int g = ctx->op % ctx->n_ghosts;
+    command_t cmd = {((ctx->op / ctx->n_ghosts) & 1) ? 'A' : 'D', 1, 1};
+    move_ghost(&ctx->board, g, &cmd);
+}
+
+static void op_move_ghost_charged(bench_ctx_t* ctx) {
+    int g = ctx->op % ctx->n_ghosts;
+    move_ghost_charged(&ctx->board, g, ((ctx->op / ctx->n_ghosts) & 1) ? 'A' : 'D');
+}
+
+static void op_render_board(bench_ctx_t* ctx) {
+    render_board(&ctx->board, ctx->frame);
+}
+
+static void op_rle_encode(bench_ctx_t* ctx) {
+    ctx->rle_len = rle_encode(ctx->frame, ctx->size * ctx->size, ctx->rle_buf, ctx->size * ctx->size);
+}
+
+static void op_rle_decode(bench_ctx_t* ctx) {
+    rle_decode(ctx->rle_buf, ctx->rle_len, ctx->frame, ctx->size * ctx->size);
+}
+
+static void op_get_board_displayed(bench_ctx_t* ctx) {
+    free(get_board_displayed(&ctx->board));
+}
+
+static void op_load_level(bench_ctx_t* ctx) {
+    (void)ctx;
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    if (load_level(&board, "bench.lvl", bench_dir, 0) == 0) unload_level(&board);
+}
+
+static void op_read_line(bench_ctx_t* ctx) {
+    (void)ctx;
+    char buf[MAX_COMMAND_LENGTH];
+    int fd = open(level_path, O_RDONLY);
+    while (read_line(fd, buf) > 0);
+    close(fd);
+}
+
+static void op_line_reader(bench_ctx_t* ctx) {
+    (void)ctx;
+    line_reader_t reader;
+    char* line;
+    int fd = open(level_path, O_RDONLY);
+    line_reader_open(&reader, fd);
+    while (line_reader_next(&reader, &line) > 0);
+    line_reader_close(&reader);
+    close(fd);
+}
+
+// --- Medição e saída ---
+
+typedef struct {
+    char name[BENCH_NAME_SIZE];
+    int size;
+    int n_ghosts;
+    double ns_per_op;
+} baseline_row_t;
+
+static baseline_row_t baseline[MAX_BASELINE_ROWS];
+static int n_baseline = 0;
+static int json_output = 0;
+static int rows_printed = 0;
+
+static int load_baseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL && n_baseline < MAX_BASELINE_ROWS) {
+        baseline_row_t* row = &baseline[n_baseline];
+        if (sscanf(line, "%31[^,],%d,%d,%lf", row->name, &row->size, &row->n_ghosts, &row->ns_per_op) == 4) {
+            n_baseline++;
+        }
+    }
+    fclose(f);
+    return n_baseline;
+}
+
+static const baseline_row_t* find_baseline(const char* name, int size, int n_ghosts) {
+    for (int i = 0; i < n_baseline; i++) {
+        if (strcmp(baseline[i].name, name) == 0 && baseline[i].size == size && baseline[i].n_ghosts == n_ghosts) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+static void print_row(const char* name, int size, int n_ghosts, double ns, double allocs, double ratio) {
+    const baseline_row_t* base = find_baseline(name, size, n_ghosts);
+    double change = base && base->ns_per_op > 0 ? (ns - base->ns_per_op) * 100.0 / base->ns_per_op : 0;
+
+    if (json_output) {
+        printf("%s  {\"benchmark\": \"%s\", \"size\": %d, \"ghosts\": %d, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f",
+               rows_printed ? ",\n" : "", name, size, n_ghosts, ns, allocs);
+        if (ratio > 0) printf(", \"compression_ratio\": %.2f", ratio);
+        if (base) printf(", \"baseline_ns_per_op\": %.1f, \"change_pct\": %.1f", base->ns_per_op, change);
+        printf("}");
+    } else {
+        printf("%s,%d,%d,%.1f,%.3f,", name, size, n_ghosts, ns, allocs);
+        if (ratio > 0) printf("%.2f", ratio);
+        if (n_baseline > 0) {
+            if (base) printf(",%.1f,%+.1f", base->ns_per_op, change);
+            else printf(",,");
+        }
+        printf("\n");
+    }
+    rows_printed++;
+    fflush(stdout);
+}
+
+// Corre op em lotes que duplicam até passar MIN_BENCH_NS, para o relógio não pesar nas operações rápidas
+static void run_bench(const char* name, void (*op)(bench_ctx_t*), bench_ctx_t* ctx) {
+    long long iterations = 0;
+    long long batch = 1;
+    unsigned long long allocs_before = alloc_count;
+    long long start = now_ns();
+    long long elapsed;
+
+    do {
+        for (long long i = 0; i < batch; i++) {
+            op(ctx);
+            ctx->op++;
+        }
+        iterations += batch;
+        if (batch < (1 << 20)) batch *= 2;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_BENCH_NS || iterations < MIN_ITERATIONS);
+
+    print_row(name, ctx->size, ctx->n_ghosts, (double)elapsed / iterations,
+              (double)(alloc_count - allocs_before) / iterations, ctx->compression_ratio);
+}
+
+static int parse_list(char* arg, int* out, int max) {
+    int n = 0;
+    for (char* tok = strtok(arg, ","); tok && n < max; tok = strtok(NULL, ",")) out[n++] = atoi(tok);
+    return n;
+}
+
+static void bench_size(int size, const int* ghost_counts, int n_counts) {
+    bench_ctx_t ctx;
+
+    // Leitura de linhas: só depende do tamanho do ficheiro
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.size = size;
+    if (write_level(size, 0) < 0) return;
+    run_bench("read_line", op_read_line, &ctx);
+    run_bench("line_reader", op_line_reader, &ctx);
+    remove_level_files(0);
+
+    for (int c = 0; c < n_counts; c++) {
+        int n_ghosts = ghost_counts[c];
+        int max_fit = ((size - 2) / 2) * ((size - 3) / 2);
+        if (n_ghosts <= 0 || n_ghosts > max_fit) continue;
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.size = size;
+        ctx.n_ghosts = n_ghosts;
+        if (write_level(size, n_ghosts) < 0) return;
+
+        run_bench("load_level", op_load_level, &ctx);
+
+        if (load_level(&ctx.board, "bench.lvl", bench_dir, 0) < 0) {
+            remove_level_files(n_ghosts);
+            continue;
+        }
+        ctx.frame = malloc(size * size);
+
+        run_bench("move_pacman", op_move_pacman, &ctx);
+        run_bench("move_ghost", op_move_ghost, &ctx);
+        run_bench("move_ghost_charged", op_move_ghost_charged, &ctx);
+        run_bench("render_board", op_render_board, &ctx);
+
+        // Keyframe tal como a sessão o comprime: o tabuleiro acabado de desenhar
+        ctx.rle_buf = malloc(size * size);
+        render_board(&ctx.board, ctx.frame);
+        op_rle_encode(&ctx);
+        if (ctx.rle_len > 0) {
+            ctx.compression_ratio = (double)(size * size) / ctx.rle_len;
+            run_bench("rle_encode", op_rle_encode, &ctx);
+            run_bench("rle_decode", op_rle_decode, &ctx);
+            ctx.compression_ratio = 0;
+        }
+        free(ctx.rle_buf);
+
+        run_bench("get_board_displayed", op_get_board_displayed, &ctx);
+
+        // Com o .lvlb presente o load_level passa a usar o formato binário
+        char lvlb_path[MAX_FILENAME * 2];
+        snprintf(lvlb_path, sizeof(lvlb_path), "%s/bench.lvlb", bench_dir);
+        board_t source;
+        memset(&source, 0, sizeof(source));
+        if (read_level(&source, "bench.lvl", bench_dir) == 0 && read_pacman(&source, 0) == 0 &&
+            read_ghosts(&source) == 0 && write_level_binary(&source, lvlb_path) == 0) {
+            run_bench("load_level_lvlb", op_load_level, &ctx);
+        }
+        unload_level(&source);
+
+        free(ctx.frame);
+        unload_level(&ctx.board);
+        remove_level_files(n_ghosts);
+    }
+}
+
+int main(int argc, char** argv) {
+    int sizes[MAX_BENCH_SIZES] = {20, 50, 100, 200, 500, 1000, 2000};
+    int n_sizes = 7;
+    // O MON de um nível aceita no máximo MAX_GHOSTS - 1 ficheiros
+    int ghost_counts[MAX_BENCH_SIZES] = {1, 8, MAX_GHOSTS - 1};
+    int n_counts = 3;
+    const char* baseline_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "jc:s:g:")) != -1) {
+        switch (opt) {
+            case 'j': json_output = 1; break;
+            case 'c': baseline_path = optarg; break;
+            case 's': n_sizes = parse_list(optarg, sizes, MAX_BENCH_SIZES); break;
+            case 'g': n_counts = parse_list(optarg, ghost_counts, MAX_BENCH_SIZES); break;
+            default:
+                fprintf(stderr, "Usage: %s [-j] [-c baseline.csv] [-s sizes] [-g ghost_counts]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (baseline_path && load_baseline(baseline_path) <= 0) {
+        fprintf(stderr, "bench_engine: baseline %s vazia ou ilegível\n", baseline_path);
+        return 1;
+    }
+
+    open_debug_file("/dev/null");
+
+    char dir_template[] = "/tmp/bench_engine_XXXXXX";
+    bench_dir = mkdtemp(dir_template);
+    if (!bench_dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(level_path, sizeof(level_path), "%s/bench.lvl", bench_dir);
+
+    if (json_output) printf("[\n");
+    else printf("benchmark,size,ghosts,ns_per_op,allocs_per_op,compression_ratio%s\n",
+                n_baseline > 0 ? ",baseline_ns_per_op,change_pct" : "");
+
+    for (int i = 0; i < n_sizes; i++) bench_size(sizes[i], ghost_counts, n_counts);
+
+    if (json_output) printf("\n]\n");
+
+    rmdir(bench_dir);
+    close_debug_file();
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Microbenchmark do parser de níveis: tempo de leitura em função do tamanho do nível.
+// Gera níveis sintéticos N x N numa diretoria temporária e compara o read_line antigo
+// (um read por carácter) com o line_reader, e mede o read_level completo.
+// Saída em CSV: size,cells,file_bytes,read_line_ns,line_reader_ns,read_level_ns
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "board.h"
+#include "parser.h"
+#include "debug.h"
+
+#define MIN_BENCH_NS 200000000LL // cada medição corre pelo menos 0.2 s
+#define MIN_ITERATIONS 3
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Nível N x N: parede à volta, pontos no interior e um portal
+static long write_level(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "#DIM: linhas colunas\nDIM %d %d\nTEMPO 200\n", n, n);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            char c = 'o';
+            if (y == 0 || x == 0 || y == n - 1 || x == n - 1) c = 'X';
+            else if (y == 1 && x == n - 2) c = '@';
+            fputc(c, f);
+        }
+        fputc('\n', f);
+    }
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void scan_read_line(const char* path) {
+    char buf[MAX_COMMAND_LENGTH];
+    int fd = open(path, O_RDONLY);
+    while (read_line(fd, buf) > 0);
+    close(fd);
+}
+
+static void scan_line_reader(const char* path) {
+    line_reader_t reader;
+    char* line;
+    int fd = open(path, O_RDONLY);
+    line_reader_open(&reader, fd);
+    while (line_reader_next(&reader, &line) > 0);
+    line_reader_close(&reader);
+    close(fd);
+}
+
+static char* bench_dir;
+
+static void parse_level(const char* path) {
+    (void)path;
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    if (read_level(&board, "bench.lvl", bench_dir) == 0) {
+        free(board.content);
+        free(board.dots);
+        free(board.portals);
+        free(board.pacmans);
+        free(board.ghosts);
+    }
+}
+
+// Tempo médio por chamada, em ns
+static long long time_op(void (*op)(const char*), const char* path) {
+    long long start = now_ns();
+    long long elapsed;
+    int iterations = 0;
+    do {
+        op(path);
+        iterations++;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_BENCH_NS || iterations < MIN_ITERATIONS);
+    return elapsed / iterations;
+}
+
+int main(int argc, char** argv) {
+    int sizes[] = {20, 50, 100, 200, 500, 1000};
+    int n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    if (argc > 1) {
+        // Tamanhos escolhidos na linha de comandos
+        n_sizes = argc - 1 < n_sizes ? argc - 1 : n_sizes;
+        for (int i = 0; i < n_sizes; i++) sizes[i] = atoi(argv[i + 1]);
+    }
+
+    open_debug_file("/dev/null");
+
+    char dir_template[] = "/tmp/bench_parser_XXXXXX";
+    bench_dir = mkdtemp(dir_template);
+    if (!bench_dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char path[MAX_FILENAME];
+    snprintf(path, sizeof(path), "%s/bench.lvl", bench_dir);
+
+    printf("size,cells,file_bytes,read_line_ns,line_reader_ns,read_level_ns\n");
+    for (int i = 0; i < n_sizes; i++) {
+        long bytes = write_level(path, sizes[i]);
+        if (bytes < 0) break;
+        long long t_read_line = time_op(scan_read_line, path);
+        long long t_reader = time_op(scan_line_reader, path);
+        long long t_level = time_op(parse_level, path);
+        printf("%d,%d,%ld,%lld,%lld,%lld\n", sizes[i], sizes[i] * sizes[i], bytes,
+               t_read_line, t_reader, t_level);
+        fflush(stdout);
+    }
+
+    unlink(path);
+    rmdir(bench_dir);
+    close_debug_file();
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "api.h"
 #include "protocol.h"
 #include "debug.h"
+#include "frame_shm.h"
+#include "rle.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -9,6 +11,20 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <poll.h>
+
+#define READER_BUFFER_SIZE 4096
+#define SHM_POLL_INTERVAL_MS 100    // de quanto em quanto tempo se confirma que o servidor está vivo
+#define SPECTATE_TIMEOUT_MS 5000    // espera máxima pela resposta a OP_CODE_SPECTATE
+
+// Leitor com buffer sobre o pipe de notificações: junta várias mensagens por read
+// e trata leituras parciais, que de outra forma partiriam o fluxo a meio de uma mensagem.
+typedef struct {
+  int fd;
+  size_t start;
+  size_t end;
+  char buffer[READER_BUFFER_SIZE];
+} frame_reader_t;
 
 struct Session {
   int id;
@@ -16,9 +32,88 @@ struct Session {
   int notif_pipe;
   char req_pipe_path[MAX_PIPE_PATH_LENGTH + 1];
   char notif_pipe_path[MAX_PIPE_PATH_LENGTH + 1];
+  // Último tabuleiro recebido, base para aplicar os OP_CODE_BOARD_DELTA
+  char *grid;
+  int grid_width;
+  int grid_height;
+  frame_reader_t reader;
+  // Payload do último delta recebido (reutilizado entre mensagens)
+  char *payload;
+  size_t payload_capacity;
+  // Transporte por memória partilhada (NULL: tabuleiros pelo pipe de notificações)
+  frame_shm_t *shm;
+  unsigned int shm_seq;     // último tabuleiro lido do segmento
 };
 
 static struct Session session = {.id = -1};
+static int requested_transport = PACMAN_TRANSPORT_FIFO;
+static int requested_view_width = 0;
+static int requested_view_height = 0;
+
+// Alocações feitas pela api desde o arranque (ver api_allocation_count)
+static unsigned long long allocation_count = 0;
+
+static void *api_realloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (p != NULL) __atomic_fetch_add(&allocation_count, 1, __ATOMIC_RELAXED);
+    return p;
+}
+
+unsigned long long api_allocation_count(void) {
+    return __atomic_load_n(&allocation_count, __ATOMIC_RELAXED);
+}
+
+void pacman_set_transport(int transport) {
+    requested_transport = transport;
+}
+
+void pacman_set_viewport(int width, int height) {
+    requested_view_width = width;
+    requested_view_height = height;
+}
+
+int pacman_transport(void) {
+    return session.shm ? PACMAN_TRANSPORT_SHM : PACMAN_TRANSPORT_FIFO;
+}
+
+// Lê exatamente n bytes para dst. Devolve 0 em sucesso, -1 em EOF ou erro.
+static int reader_read_exact(frame_reader_t *r, void *dst, size_t n) {
+    char *out = dst;
+
+    while (n > 0) {
+        size_t available = r->end - r->start;
+        if (available > 0) {
+            size_t chunk = available < n ? available : n;
+            memcpy(out, r->buffer + r->start, chunk);
+            r->start += chunk;
+            out += chunk;
+            n -= chunk;
+            continue;
+        }
+
+        // Leituras grandes vão diretas para o destino, sem passar pelo buffer
+        ssize_t got;
+        if (n >= READER_BUFFER_SIZE) {
+            got = read(r->fd, out, n);
+            if (got > 0) {
+                out += got;
+                n -= got;
+                continue;
+            }
+        } else {
+            got = read(r->fd, r->buffer, READER_BUFFER_SIZE);
+            if (got > 0) {
+                r->start = 0;
+                r->end = got;
+                continue;
+            }
+        }
+
+        if (got < 0 && errno == EINTR) continue;
+        return -1;
+    }
+    return 0;
+}
 
 int pacman_connect(char const *req_pipe_path, char const *notif_pipe_path, char const *server_pipe_path) {
     
@@ -26,19 +121,29 @@ int pacman_connect(char const *req_pipe_path, char const *notif_pipe_path, char
     if (mkfifo(req_pipe_path, 0666) < 0 && errno != EEXIST) return 1;
     if (mkfifo(notif_pipe_path, 0666) < 0 && errno != EEXIST) return 1;
 
-    // 2. Preparar a mensagem (OP_CODE + Caminhos)
-    char buffer[1 + 2 * MAX_PIPE_PATH_LENGTH];
+    // 2. Preparar a mensagem (OP_CODE + Caminhos + Capacidades [+ Janela])
+    char buffer[CONNECT_VIEWPORT_REQUEST_SIZE];
     memset(buffer, 0, sizeof(buffer));
+    size_t request_size = CONNECT_EXT_REQUEST_SIZE;
     
-    buffer[0] = (char)OP_CODE_CONNECT;
+    buffer[0] = (char)OP_CODE_CONNECT_EXT;
     strncpy(buffer + 1, req_pipe_path, MAX_PIPE_PATH_LENGTH);
     strncpy(buffer + 1 + MAX_PIPE_PATH_LENGTH, notif_pipe_path, MAX_PIPE_PATH_LENGTH);
+    unsigned char caps = CLIENT_CAP_DELTA | CLIENT_CAP_RLE;
+    if (requested_transport == PACMAN_TRANSPORT_SHM) caps |= CLIENT_CAP_SHM;
+    if (requested_view_width > 0 && requested_view_height > 0) {
+        caps |= CLIENT_CAP_VIEWPORT;
+        memcpy(buffer + CONNECT_EXT_REQUEST_SIZE, &requested_view_width, sizeof(int));
+        memcpy(buffer + CONNECT_EXT_REQUEST_SIZE + sizeof(int), &requested_view_height, sizeof(int));
+        request_size = CONNECT_VIEWPORT_REQUEST_SIZE;
+    }
+    buffer[CONNECT_REQUEST_SIZE] = (char)caps;
 
     // 3. Abrir o FIFO do servidor e enviar pedido
     int server_fd = open(server_pipe_path, O_WRONLY);
     if (server_fd < 0) return 1;
     
-    if (write(server_fd, buffer, sizeof(buffer)) != sizeof(buffer)) {
+    if (write(server_fd, buffer, request_size) != (ssize_t)request_size) {
         close(server_fd);
         return 1;
     }
@@ -55,16 +160,32 @@ int pacman_connect(char const *req_pipe_path, char const *notif_pipe_path, char
         return 1;
     }
 
-    // 5. Validar confirmação do servidor
-    char response[2];
-    if (read(session.notif_pipe, response, 2) != 2) return 1;
+    session.reader.fd = session.notif_pipe;
+    session.reader.start = session.reader.end = 0;
 
-    if (response[0] != (char)OP_CODE_CONNECT || response[1] != 0) {
+    // 5. Validar confirmação do servidor (e as capacidades que aceitou)
+    char response[CONNECT_EXT_RESPONSE_SIZE];
+    if (reader_read_exact(&session.reader, response, CONNECT_EXT_RESPONSE_SIZE) < 0 ||
+        response[0] != (char)OP_CODE_CONNECT || response[1] != 0) {
         close(session.notif_pipe);
         close(session.req_pipe);
         return 1;
     }
 
+    // Sem CLIENT_CAP_SHM aceite, os tabuleiros chegam pelo pipe como sempre
+    session.shm = NULL;
+    session.shm_seq = 0;
+    if ((unsigned char)response[2] & CLIENT_CAP_SHM) {
+        char shm_name[FRAME_SHM_NAME_LENGTH];
+        frame_shm_name(notif_pipe_path, shm_name);
+        session.shm = frame_shm_open(shm_name);
+        if (session.shm == NULL) {
+            close(session.notif_pipe);
+            close(session.req_pipe);
+            return 1;
+        }
+    }
+
     // Guardar estado na variável static
     strncpy(session.req_pipe_path, req_pipe_path, MAX_PIPE_PATH_LENGTH);
     strncpy(session.notif_pipe_path, notif_pipe_path, MAX_PIPE_PATH_LENGTH);
@@ -73,6 +194,48 @@ int pacman_connect(char const *req_pipe_path, char const *notif_pipe_path, char
     return 0;
 }
 
+int pacman_spectate(char const *notif_pipe_path, char const *server_pipe_path, char const *player_id) {
+    if (mkfifo(notif_pipe_path, 0666) < 0 && errno != EEXIST) return 1;
+
+    // Aberto antes do pedido (sem escritor não bloqueia): o servidor abre o seu lado sem esperar
+    session.notif_pipe = open(notif_pipe_path, O_RDONLY | O_NONBLOCK);
+    if (session.notif_pipe < 0) return 1;
+
+    char buffer[SPECTATE_REQUEST_SIZE];
+    memset(buffer, 0, sizeof(buffer));
+    buffer[0] = (char)OP_CODE_SPECTATE;
+    // Campos de tamanho fixo: snprintf trunca a MAX_PIPE_PATH_LENGTH - 1 e termina sempre
+    snprintf(buffer + 1, MAX_PIPE_PATH_LENGTH, "%s", notif_pipe_path);
+    snprintf(buffer + 1 + MAX_PIPE_PATH_LENGTH, MAX_PIPE_PATH_LENGTH, "%s", player_id);
+
+    int server_fd = open(server_pipe_path, O_WRONLY);
+    int sent = server_fd >= 0 && write(server_fd, buffer, sizeof(buffer)) == sizeof(buffer);
+    if (server_fd >= 0) close(server_fd);
+
+    // Espera pela resposta; a partir daí o pipe é lido em modo bloqueante, como o dos jogadores
+    struct pollfd pfd = {.fd = session.notif_pipe, .events = POLLIN};
+    char response[2];
+    session.reader.fd = session.notif_pipe;
+    session.reader.start = session.reader.end = 0;
+    if (!sent || poll(&pfd, 1, SPECTATE_TIMEOUT_MS) <= 0 ||
+        fcntl(session.notif_pipe, F_SETFL, fcntl(session.notif_pipe, F_GETFL) & ~O_NONBLOCK) < 0 ||
+        reader_read_exact(&session.reader, response, 2) < 0 ||
+        response[0] != (char)OP_CODE_SPECTATE || response[1] != 0) {
+        close(session.notif_pipe);
+        session.notif_pipe = -1;
+        unlink(notif_pipe_path);
+        return 1;
+    }
+
+    // Sem pipe de pedidos: pacman_play não faz nada e pacman_disconnect só fecha o pipe
+    session.req_pipe = -1;
+    session.req_pipe_path[0] = '\0';
+    strncpy(session.notif_pipe_path, notif_pipe_path, MAX_PIPE_PATH_LENGTH);
+    session.shm = NULL;
+    session.id = 1;
+    return 0;
+}
+
 void pacman_play(char command) {
     if (session.id == -1 || session.req_pipe < 0) return;
 
@@ -129,6 +292,15 @@ int pacman_disconnect() {
         session.notif_pipe_path[0] = '\0';
     }
 
+    frame_shm_unmap(session.shm);
+    session.shm = NULL;
+    free(session.grid);
+    session.grid = NULL;
+    session.grid_width = session.grid_height = 0;
+    free(session.payload);
+    session.payload = NULL;
+    session.payload_capacity = 0;
+
     // 4. Marcar sessão como encerrada
     session.id = -1;
 
@@ -137,45 +309,176 @@ int pacman_disconnect() {
     return error; 
 }
 
-Board receive_board_update(void) {
-    Board board;
-    board.data = NULL; // Inicializar para evitar problemas em caso de erro
-
+// Lê a próxima mensagem de tabuleiro e aplica-a a session.grid; preenche os campos de board
+// exceto data. Devolve 0 em sucesso, -1 se a ligação terminou ou a mensagem é inválida.
+static int receive_into_grid(Board *board) {
     // 1. Verificar se a sessão está ativa
     if (session.id == -1 || session.notif_pipe < 0) {
-        return board;
+        return -1;
     }
 
-    // 2. Ler o OP_CODE para confirmar se é uma atualização de tabuleiro
-    char op_code;
-    if (read(session.notif_pipe, &op_code, sizeof(char)) <= 0) {
-        return board;
+    // 2. Ler o cabeçalho completo: (char) op | 6 ints | (int) payload_size
+    frame_header_t header;
+    if (reader_read_exact(&session.reader, &header, sizeof(header)) < 0) {
+        return -1;
     }
 
-    if (op_code != (char)OP_CODE_BOARD) { // OP_CODE_BOARD é 4
+    if (header.op_code != (char)OP_CODE_BOARD && header.op_code != (char)OP_CODE_BOARD_DELTA &&
+        header.op_code != (char)OP_CODE_BOARD_RLE) {
+        return -1;
+    }
+
+    board->width = header.width;
+    board->height = header.height;
+    board->tempo = header.tempo;
+    board->victory = header.victory;
+    board->game_over = header.game_over;
+    board->accumulated_points = header.points;
+    board->view_x = header.view_x;
+    board->view_y = header.view_y;
+
+    int board_size = board->width * board->height;
+    if (board->width <= 0 || board->height <= 0 || header.payload_size < 0) return -1;
+
+    // 3. Atualizar o tabuleiro persistente (completo, comprimido ou apenas as células alteradas)
+    if (header.op_code != (char)OP_CODE_BOARD_DELTA) {
+        // Um tabuleiro comprimido só é enviado quando fica mais pequeno do que o original
+        if (header.op_code == (char)OP_CODE_BOARD && header.payload_size != board_size) return -1;
+        if (header.op_code == (char)OP_CODE_BOARD_RLE && header.payload_size >= board_size) return -1;
+        if (board->width != session.grid_width || board->height != session.grid_height) {
+            char *grid = api_realloc(session.grid, board_size);
+            if (grid == NULL) return -1;
+            session.grid = grid;
+            session.grid_width = board->width;
+            session.grid_height = board->height;
+
+            // Os deltas e os tabuleiros comprimidos nunca passam do tamanho do tabuleiro:
+            // reserva-se já, para que a primeira mensagem do nível não tenha de alocar
+            if ((size_t)board_size > session.payload_capacity) {
+                char *payload = api_realloc(session.payload, board_size);
+                if (payload == NULL) return -1;
+                session.payload = payload;
+                session.payload_capacity = board_size;
+            }
+        }
+        if (header.op_code == (char)OP_CODE_BOARD) {
+            if (reader_read_exact(&session.reader, session.grid, board_size) < 0) return -1;
+        } else {
+            if (reader_read_exact(&session.reader, session.payload, header.payload_size) < 0) return -1;
+            if (rle_decode(session.payload, header.payload_size, session.grid, board_size) < 0) return -1;
+        }
+    } else {
+        if ((size_t)header.payload_size > session.payload_capacity) {
+            char *payload = api_realloc(session.payload, header.payload_size);
+            if (payload == NULL) return -1;
+            session.payload = payload;
+            session.payload_capacity = header.payload_size;
+        }
+        if (reader_read_exact(&session.reader, session.payload, header.payload_size) < 0) return -1;
+
+        // Um delta sem tabuleiro base compatível é um erro de protocolo
+        if (session.grid == NULL || board->width != session.grid_width || board->height != session.grid_height) {
+            return -1;
+        }
+
+        const char *p = session.payload;
+        const char *p_end = session.payload + header.payload_size;
+        int n_runs;
+        if (p_end - p < (long)sizeof(int)) return -1;
+        memcpy(&n_runs, p, sizeof(int));
+        p += sizeof(int);
+
+        for (int i = 0; i < n_runs; i++) {
+            int index, len;
+            if (p_end - p < (long)(2 * sizeof(int))) return -1;
+            memcpy(&index, p, sizeof(int));
+            memcpy(&len, p + sizeof(int), sizeof(int));
+            p += 2 * sizeof(int);
+            if (index < 0 || len < 0 || index + len > board_size || p_end - p < len) return -1;
+            memcpy(session.grid + index, p, len);
+            p += len;
+        }
+    }
+
+    return 0;
+}
+
+// Memória partilhada: copia o próximo tabuleiro do segmento diretamente para cells
+// (com pelo menos session.shm->capacity bytes). Devolve 0 em sucesso, -1 se a sessão terminou.
+static int receive_from_shm(Board *board, char *cells) {
+    frame_header_t header;
+    while (1) {
+        int result = frame_shm_read(session.shm, &session.shm_seq, &header, cells, SHM_POLL_INTERVAL_MS);
+        if (result < 0) return -1;
+        if (result > 0) break;
+
+        // Sem tabuleiros há algum tempo: o pipe de notificações fecha-se se o servidor morreu
+        struct pollfd pfd = {.fd = session.notif_pipe, .events = POLLIN};
+        if (poll(&pfd, 1, 0) > 0) return -1;
+    }
+
+    board->width = header.width;
+    board->height = header.height;
+    board->tempo = header.tempo;
+    board->victory = header.victory;
+    board->game_over = header.game_over;
+    board->accumulated_points = header.points;
+    board->view_x = header.view_x;
+    board->view_y = header.view_y;
+    return 0;
+}
+
+Board receive_board_update(void) {
+    Board board;
+    board.data = NULL; // Inicializar para evitar problemas em caso de erro
+    if (session.id == -1) return board;
+
+    if (session.shm) {
+        char *data = api_realloc(NULL, session.shm->capacity);
+        if (data == NULL) return board;
+        if (receive_from_shm(&board, data) < 0) {
+            free(data);
+            return board;
+        }
+        board.data = data;
         return board;
     }
 
-    // 3. Ler os metadados (6 inteiros: width, height, tempo, victory, game_over, points)
-    // De acordo com o formato: (int) width | (int) height | (int) tempo | (int) victory | (int) game_over | (int) points 
-    if (read(session.notif_pipe, &board.width, sizeof(int)) <= 0) return board;
-    if (read(session.notif_pipe, &board.height, sizeof(int)) <= 0) return board;
-    if (read(session.notif_pipe, &board.tempo, sizeof(int)) <= 0) return board;
-    if (read(session.notif_pipe, &board.victory, sizeof(int)) <= 0) return board;
-    if (read(session.notif_pipe, &board.game_over, sizeof(int)) <= 0) return board;
-    if (read(session.notif_pipe, &board.accumulated_points, sizeof(int)) <= 0) return board;
+    if (receive_into_grid(&board) < 0) return board;
 
-    // 4. Alocar memória para os dados do tabuleiro (width * height)
+    // Devolver uma cópia (quem chama liberta board.data)
     int board_size = board.width * board.height;
-    board.data = malloc(board_size * sizeof(char));
+    board.data = api_realloc(NULL, board_size * sizeof(char));
     if (board.data == NULL) return board;
+    memcpy(board.data, session.grid, board_size);
 
-    // 5. Ler os dados do tabuleiro propriamente ditos
-    if (read(session.notif_pipe, board.data, board_size) != board_size) {
-        free(board.data);
-        board.data = NULL;
-        return board;
+    return board;
+}
+
+int receive_board_update_into(Board *board, size_t *capacity) {
+    if (session.id == -1) return -1;
+
+    // O segmento tem o tamanho do maior nível: o buffer cresce uma vez e nunca mais
+    if (session.shm) {
+        if ((size_t)session.shm->capacity > *capacity) {
+            char *grown = api_realloc(board->data, session.shm->capacity);
+            if (grown == NULL) return -1;
+            board->data = grown;
+            *capacity = session.shm->capacity;
+        }
+        return receive_from_shm(board, board->data);
     }
 
-    return board;
+    if (receive_into_grid(board) < 0) return -1;
+
+    // O buffer só cresce quando chega um tabuleiro maior do que todos os anteriores
+    size_t board_size = (size_t)board->width * board->height;
+    if (board_size > *capacity) {
+        char *grown = api_realloc(board->data, board_size);
+        if (grown == NULL) return -1;
+        board->data = grown;
+        *capacity = board_size;
+    }
+    memcpy(board->data, session.grid, board_size);
+    return 0;
 }
\ No newline at end of file
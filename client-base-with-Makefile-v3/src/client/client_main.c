@@ -10,6 +10,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 
 typedef struct {
     const char *filename;
@@ -23,25 +24,31 @@ pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 // --- THREAD DE RECEÇÃO ---
 static void *receiver_thread(void *arg) {
     (void)arg;
+    // Um só buffer para todos os tabuleiros: só é realocado quando o nível cresce
+    Board updated_board = {0};
+    size_t capacity = 0;
+    unsigned long long allocations = 0;
+    int frames = 0;
     while (true) {
-        Board updated_board = receive_board_update();
-        if (!updated_board.data || updated_board.game_over == 1) {
+        if (receive_board_update_into(&updated_board, &capacity) < 0 || updated_board.game_over == 1) {
             pthread_mutex_lock(&mutex);
             stop_execution = true;
             pthread_mutex_unlock(&mutex);
-            
-            if (updated_board.data) free(updated_board.data);
-            
             break;
         }
+        // A partir do primeiro tabuleiro, só mudanças de nível deviam alocar
+        if (++frames == 1) allocations = api_allocation_count();
+
         pthread_mutex_lock(&mutex);
         session_tempo = updated_board.tempo;
         pthread_mutex_unlock(&mutex);
 
-        draw_board_client(updated_board);
-        refresh_screen();
-        if (updated_board.data) free(updated_board.data);
+        // Tabuleiro igual ao anterior: nada a enviar para o terminal
+        if (draw_board_client(updated_board)) refresh_screen();
     }
+    debug("Cliente: %d tabuleiros recebidos, %llu alocações depois do primeiro\n",
+          frames, frames > 0 ? api_allocation_count() - allocations : 0);
+    free(updated_board.data);
     return NULL;
 }
 
@@ -85,14 +92,26 @@ end:
 
 // --- MAIN ---
 int main(int argc, char *argv[]) {
-    if (argc < 3 || argc > 4) {
-        fprintf(stderr, "Usage: %s <id> <reg_pipe> [cmd_file]\n", argv[0]);
+    // -s player_id: assistir ao jogo de outro jogador em vez de jogar
+    const char *spectate_id = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            spectate_id = optarg;
+        } else {
+            fprintf(stderr, "Usage: %s [-s player_id] <id> <reg_pipe> [cmd_file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind < 2 || argc - optind > 3) {
+        fprintf(stderr, "Usage: %s [-s player_id] <id> <reg_pipe> [cmd_file]\n", argv[0]);
         return 1;
     }
 
-    const char *client_id = argv[1];
-    const char *register_pipe = argv[2];
-    const char *commands_file = (argc == 4) ? argv[3] : NULL;
+    const char *client_id = argv[optind];
+    const char *register_pipe = argv[optind + 1];
+    // Um espectador não envia comandos
+    const char *commands_file = (argc - optind == 3 && !spectate_id) ? argv[optind + 2] : NULL;
 
     char req_path[MAX_PIPE_PATH_LENGTH], notif_path[MAX_PIPE_PATH_LENGTH];
     snprintf(req_path, MAX_PIPE_PATH_LENGTH, "/tmp/%s_request", client_id);
@@ -100,7 +119,26 @@ int main(int argc, char *argv[]) {
 
     open_debug_file("client-debug.log");
 
-    if (pacman_connect(req_path, notif_path, register_pipe) != 0) return 1;
+    // PACMAN_TRANSPORT=shm: tabuleiros por memória partilhada (servidor na mesma máquina)
+    const char *transport = getenv("PACMAN_TRANSPORT");
+    if (transport && strcmp(transport, "shm") == 0) pacman_set_transport(PACMAN_TRANSPORT_SHM);
+
+    // Níveis maiores do que o terminal chegam só numa janela à volta do pacman
+    // (3 linhas de título por cima do tabuleiro e 2 de pontuação por baixo)
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 5 && ws.ws_col > 0) {
+        pacman_set_viewport(ws.ws_col, ws.ws_row - 5);
+    }
+
+    if (spectate_id) {
+        if (pacman_spectate(notif_path, register_pipe, spectate_id) != 0) {
+            fprintf(stderr, "Sem jogo ativo de %s para assistir\n", spectate_id);
+            return 1;
+        }
+    } else if (pacman_connect(req_path, notif_path, register_pipe) != 0) {
+        return 1;
+    }
+    debug("Cliente: tabuleiros pelo %s\n", pacman_transport() == PACMAN_TRANSPORT_SHM ? "segmento partilhado" : "pipe");
 
     pthread_t recv_tid;
     pthread_create(&recv_tid, NULL, receiver_thread, NULL);
@@ -136,7 +174,7 @@ int main(int argc, char *argv[]) {
 
         // --- LÓGICA DE BLOQUEIO DO TECLADO ---
         // Se houver um ficheiro (has_auto == true), ignoramos W,A,S,D do teclado
-        if (!has_auto) {
+        if (!has_auto && !spectate_id) {
             if (cmd == 'W' || cmd == 'A' || cmd == 'S' || cmd == 'D') {
                 pacman_play(cmd);
             }
@@ -2,9 +2,21 @@
 #include "board.h"
 #include "api.h"
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 
+// What is currently on the screen, so each frame only touches the cells that changed
+static struct {
+    char* cells;
+    int capacity;
+    int width;
+    int height;
+    int points;
+    int status;     // DRAW_MENU while playing, DRAW_GAME_OVER or DRAW_WIN
+    int valid;      // 0 forces a full redraw (first frame, new level, after terminal_init)
+} shown = {NULL, 0, 0, 0, 0, DRAW_MENU, 0};
+
 int terminal_init() {
     // Initialize ncurses mode
     initscr();
@@ -42,92 +54,97 @@ int terminal_init() {
 
     // Clear the screen
     clear();
+    shown.valid = 0;
     flushinp(); //limpar input
 
     return 0;
 }
 
 
-void draw_board_client(Board board) {
-    // Clear the screen before redrawing
-    clear();
-
-    // Draw the border/title
-    attron(COLOR_PAIR(5));
-    mvprintw(0, 0, "=== PACMAN GAME ===");
-    if (board.game_over) {
-        mvprintw(1, 0, " GAME OVER ");
-    } else if (board.victory) {
-        mvprintw(1, 0, " VICTORY ");
-    } else {
-        mvprintw(1, 0, " Use W/A/S/D to move | Q to quit");
+static void draw_cell(int row, int col, char ch) {
+    chtype attrs;
+    switch (ch) {
+        case '#': attrs = COLOR_PAIR(3); break;                     // Wall
+        case 'C': attrs = COLOR_PAIR(1) | A_BOLD; break;            // Pacman
+        case 'M': attrs = COLOR_PAIR(2) | A_BOLD; break;            // Monster/Ghost
+        case 'G': attrs = COLOR_PAIR(2) | A_BOLD | A_DIM; ch = 'M'; break; // Charged Monster/Ghost
+        case '.': attrs = COLOR_PAIR(4); break;                     // Dot
+        case '@': attrs = COLOR_PAIR(6); break;                     // Portal
+        default: attrs = A_NORMAL; break;
     }
+    mvaddch(row, col, (chtype)(unsigned char)ch | attrs);
+}
 
+int draw_board_client(Board board) {
     // Starting row for the game board (leave space for UI)
     int start_row = 3;
+    int size = board.width * board.height;
+    int status = board.game_over ? DRAW_GAME_OVER : board.victory ? DRAW_WIN : DRAW_MENU;
+
+    // A new level (or the first frame) changes the layout: start from a blank screen
+    if (!shown.valid || board.width != shown.width || board.height != shown.height) {
+        if (size > shown.capacity) {
+            char* grown = realloc(shown.cells, size);
+            if (grown == NULL) return 0;
+            shown.cells = grown;
+            shown.capacity = size;
+        }
+        clear();
+        attron(COLOR_PAIR(5));
+        mvprintw(0, 0, "=== PACMAN GAME ===");
+        attroff(COLOR_PAIR(5));
+        shown.width = board.width;
+        shown.height = board.height;
+        shown.status = -1;
+        shown.points = board.accumulated_points - 1;
+        for (int i = 0; i < size; i++) {
+            shown.cells[i] = board.data[i];
+            draw_cell(start_row + i / board.width, i % board.width, board.data[i]);
+        }
+        shown.valid = 1;
+    }
 
-    // Draw the board
+    int changed = 0;
     for (int y = 0; y < board.height; y++) {
+        const char* row = board.data + y * board.width;
+        char* old = shown.cells + y * board.width;
+        if (memcmp(row, old, board.width) == 0) continue;
         for (int x = 0; x < board.width; x++) {
-            char ch = board.data[y * board.width + x];
-
-            // Move cursor to position
-            move(start_row + y, x);
-
-            // Draw with appropriate color
-            switch (ch) {
-                case '#': // Wall
-                    attron(COLOR_PAIR(3));
-                    addch('#');
-                    attroff(COLOR_PAIR(3));
-                    break;
-
-                case 'C': // Pacman
-                    attron(COLOR_PAIR(1) | A_BOLD);
-                    addch('C');
-                    attroff(COLOR_PAIR(1) | A_BOLD);
-                    break;
-
-                case 'M': // Monster/Ghost
-                    attron(COLOR_PAIR(2) | A_BOLD);
-                    addch('M');
-                    attroff(COLOR_PAIR(2) | A_BOLD);  
-                    break;
-
-                case 'G': // Charged Monster/Ghost
-                    attron((COLOR_PAIR(2) | A_BOLD) | A_DIM);
-                    addch('M');
-                    attroff((COLOR_PAIR(2) | A_BOLD) | A_DIM);  
-                    break;
-
-                case '.': // Dot
-                    attron(COLOR_PAIR(4));
-                    addch('.');
-                    attroff(COLOR_PAIR(4));
-                    break;
-
-                case '@': // Portal
-                    attron(COLOR_PAIR(6));
-                    addch('@');
-                    attroff(COLOR_PAIR(6));
-                    break;
-
-                case ' ': // Empty space
-                    addch(' ');
-                    break;
-
-                default:
-                    addch(ch);
-                    break;
-            }
+            if (row[x] == old[x]) continue;
+            old[x] = row[x];
+            draw_cell(start_row + y, x, row[x]);
+            changed = 1;
+        }
+    }
+
+    if (status != shown.status) {
+        attron(COLOR_PAIR(5));
+        move(1, 0);
+        clrtoeol();
+        if (status == DRAW_GAME_OVER) {
+            mvprintw(1, 0, " GAME OVER ");
+        } else if (status == DRAW_WIN) {
+            mvprintw(1, 0, " VICTORY ");
+        } else {
+            mvprintw(1, 0, " Use W/A/S/D to move | Q to quit");
         }
+        attroff(COLOR_PAIR(5));
+        shown.status = status;
+        changed = 1;
     }
 
     // Draw score/status at the bottom
-    attron(COLOR_PAIR(5));
-    mvprintw(start_row + board.height + 1, 0, "Points: %d",
-             board.accumulated_points);
-    attroff(COLOR_PAIR(5));
+    if (board.accumulated_points != shown.points) {
+        attron(COLOR_PAIR(5));
+        move(start_row + board.height + 1, 0);
+        clrtoeol();
+        mvprintw(start_row + board.height + 1, 0, "Points: %d", board.accumulated_points);
+        attroff(COLOR_PAIR(5));
+        shown.points = board.accumulated_points;
+        changed = 1;
+    }
+
+    return changed;
 }
 
 
@@ -172,6 +189,10 @@ char get_input() {
 void terminal_cleanup() {
     // Restore terminal settings and clean up ncurses
     endwin();
+    free(shown.cells);
+    shown.cells = NULL;
+    shown.capacity = 0;
+    shown.valid = 0;
 }
 
 void set_timeout(int timeout_ms) {
@@ -1,23 +1,23 @@
 #include "board.h"
 #include "parser.h"
+#include "level_binary.h"
 #include <stdlib.h>
 #include <stdio.h> //snprintf
+#include <string.h>
 #include <fcntl.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
-#include <pthread.h>
 #include "debug.h"
 
 // Helper private function to find and kill pacman at specific position
 static int find_and_kill_pacman(board_t* board, int new_x, int new_y) {
-    for (int p = 0; p < board->n_pacmans; p++) {
-        pacman_t* pac = &board->pacmans[p];
-        if (pac->pos_x == new_x && pac->pos_y == new_y && pac->alive) {
-            pac->alive = 0;
-            kill_pacman(board, p);
-            return DEAD_PACMAN;
-        }
+    int occupant = board->occupant[new_y * board->width + new_x];
+    if (occupant < 0 && board->pacmans[-occupant - 1].alive) {
+        int p = -occupant - 1;
+        board->pacmans[p].alive = 0;
+        kill_pacman(board, p);
+        return DEAD_PACMAN;
     }
     return VALID_MOVE;
 }
@@ -27,6 +27,11 @@ static inline int get_board_index(board_t* board, int x, int y) {
     return y * board->width + x;
 }
 
+// Helper private function for keeping the occupancy index in sync with content
+static inline void set_occupant(board_t* board, int index, int entity) {
+    board->occupant[index] = entity;
+}
+
 // Helper private function for checking valid position
 static inline int is_valid_position(board_t* board, int x, int y) {
     return (x >= 0 && x < board->width) && (y >= 0 && y < board->height); // Inside of the board boundaries
@@ -53,7 +58,7 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
 
     if (direction == 'R') {
         char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
+        direction = directions[rand_r(&board->rng_state) % 4];
     }
 
     // Calculate new position based on direction
@@ -92,88 +97,65 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
     int new_index = get_board_index(board, new_x, new_y);
     int old_index = get_board_index(board, pac->pos_x, pac->pos_y);
 
-    // locks
-    if (old_index < new_index) {
-        pthread_mutex_lock(&board->board[old_index].lock);
-        pthread_mutex_lock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_lock(&board->board[new_index].lock);
-        pthread_mutex_lock(&board->board[old_index].lock);
-    }
-
-    char target_content = board->board[new_index].content;
+    char target_content = board->content[new_index];
 
-    if (board->board[new_index].has_portal) {
-        board->board[old_index].content = ' ';
-        board->board[new_index].content = 'P';
-        if (old_index < new_index) {
-            pthread_mutex_unlock(&board->board[old_index].lock);
-            pthread_mutex_unlock(&board->board[new_index].lock);
-        }
-        else {
-            pthread_mutex_unlock(&board->board[new_index].lock);
-            pthread_mutex_unlock(&board->board[old_index].lock);
-        }
+    if (bitplane_get(board->portals, new_index)) {
+        board->content[old_index] = ' ';
+        board->content[new_index] = 'P';
+        set_occupant(board, old_index, 0);
+        set_occupant(board, new_index, -(pacman_index + 1));
         return REACHED_PORTAL;
     }
     // Check for walls
     if (target_content == 'W') {
-        goto move_pacman_invalid;
+        return INVALID_MOVE;
     }
 
     // Check for ghosts
     if (target_content == 'M') {
         kill_pacman(board, pacman_index);
-        goto move_pacman_dead;
+        return DEAD_PACMAN;
     }
 
     // Collect points
-    if (board->board[new_index].has_dot) {
+    if (bitplane_get(board->dots, new_index)) {
         pac->points++;
-        board->board[new_index].has_dot = 0;
+        bitplane_set(board->dots, new_index, 0);
     }
 
-    board->board[old_index].content = ' ';
+    board->content[old_index] = ' ';
     pac->pos_x = new_x;
     pac->pos_y = new_y;
-    board->board[new_index].content = 'P';
+    board->content[new_index] = 'P';
+    set_occupant(board, old_index, 0);
+    set_occupant(board, new_index, -(pacman_index + 1));
 
-    if (old_index < new_index) {
-        pthread_mutex_unlock(&board->board[old_index].lock);
-        pthread_mutex_unlock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_unlock(&board->board[new_index].lock);
-        pthread_mutex_unlock(&board->board[old_index].lock);
-    }
-    
     return VALID_MOVE;
+}
 
-    move_pacman_invalid:
-    if (old_index < new_index) {
-        pthread_mutex_unlock(&board->board[old_index].lock);
-        pthread_mutex_unlock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_unlock(&board->board[new_index].lock);
-        pthread_mutex_unlock(&board->board[old_index].lock);
-    }
-    return INVALID_MOVE;
-
-    move_pacman_dead:
-    if (old_index < new_index) {
-        pthread_mutex_unlock(&board->board[old_index].lock);
-        pthread_mutex_unlock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_unlock(&board->board[new_index].lock);
-        pthread_mutex_unlock(&board->board[old_index].lock);
+// Helper private function: slides a charged ghost from (x, y) one cell at a time by (dx, dy)
+// until it hits a wall, another ghost or the edge. A pacman in the way is killed and the ghost stops there.
+static int charge_ghost_path(board_t* board, int x, int y, int dx, int dy, int* out_x, int* out_y) {
+    int cx = x;
+    int cy = y;
+    while (is_valid_position(board, cx + dx, cy + dy)) {
+        char target_content = board->content[get_board_index(board, cx + dx, cy + dy)];
+        if (target_content == 'W' || target_content == 'M') {
+            break; // stop before colision
+        }
+        cx += dx;
+        cy += dy;
+        if (target_content == 'P') {
+            *out_x = cx;
+            *out_y = cy;
+            return find_and_kill_pacman(board, cx, cy);
+        }
     }
-    return DEAD_PACMAN;
+    *out_x = cx;
+    *out_y = cy;
+    return VALID_MOVE;
 }
 
-
 int move_ghost_charged(board_t* board, int ghost_index, char direction) {
     ghost_t* ghost = &board->ghosts[ghost_index];
     int x = ghost->pos_x;
@@ -187,121 +169,35 @@ int move_ghost_charged(board_t* board, int ghost_index, char direction) {
     switch (direction) {
         case 'W':
             if (y == 0) return INVALID_MOVE;
-
-            for (int i = 0; i <= y; i++) {
-                pthread_mutex_lock(&board->board[i * board->width + x].lock);
-            }
-
-            new_y = 0; // In case there is no colision
-            for (int i = y - 1; i >= 0; i--) {
-                char target_content = board->board[i * board->width + x].content;
-                if (target_content == 'W' || target_content == 'M') {
-                    new_y = i + 1; // stop before colision
-                    result = VALID_MOVE;
-                    break;
-                }
-                else if (target_content == 'P') {
-                    new_y = i;
-                    result = find_and_kill_pacman(board, new_x, new_y);
-                    break;
-                }
-            }
-
-            for (int i = 0; i <= y; i++) {
-                pthread_mutex_unlock(&board->board[i * board->width + x].lock);
-            }
+            result = charge_ghost_path(board, x, y, 0, -1, &new_x, &new_y);
             break;
         case 'S':
             if (y == board->height - 1) return INVALID_MOVE;
-
-            for (int i = y; i < board->height; i++) {
-                pthread_mutex_lock(&board->board[i * board->width + x].lock);
-            }
-
-            new_y = board->height - 1; // In case there is no colision
-            for (int i = y + 1; i < board->height; i++) {
-                char target_content = board->board[i * board->width + x].content;
-                if (target_content == 'W' || target_content == 'M') {
-                    new_y = i - 1; // stop before colision
-                    result = VALID_MOVE;
-                    break;
-                }
-                else if (target_content == 'P') {
-                    new_y = i;
-                    result = find_and_kill_pacman(board, new_x, new_y);
-                    break;
-                }
-            }
-
-            for (int i = y; i < board->height; i++) {
-                pthread_mutex_unlock(&board->board[i * board->width + x].lock);
-            }
+            result = charge_ghost_path(board, x, y, 0, 1, &new_x, &new_y);
             break;
         case 'A':
             if (x == 0) return INVALID_MOVE;
-
-            for (int j = 0; j <= x; j++) {
-                pthread_mutex_lock(&board->board[y * board->width + j].lock);
-            }
-
-            new_x = 0; // In case there is no colision
-            for (int j = x - 1; j >= 0; j--) {
-                char target_content = board->board[y * board->width + j].content;
-                if (target_content == 'W' || target_content == 'M') {
-                    new_x = j + 1; // stop before colision
-                    result = VALID_MOVE;
-                    break;
-                }
-                else if (target_content == 'P') {
-                    new_x = j;
-                    result = find_and_kill_pacman(board, new_x, new_y);
-                    break;
-                }
-            }
-
-            for (int j = 0; j <= x; j++) {
-                pthread_mutex_unlock(&board->board[y * board->width + j].lock);
-            }
+            result = charge_ghost_path(board, x, y, -1, 0, &new_x, &new_y);
             break;
         case 'D':
             if (x == board->width - 1) return INVALID_MOVE;
-
-            for (int j = x; j < board->width; j++) {
-                pthread_mutex_lock(&board->board[y * board->width + j].lock);
-            }
-
-            new_x = board->width - 1; // In case there is no colision
-            for (int j = x + 1; j < board->width; j++) {
-                char target_content = board->board[y * board->width + j].content;
-                if (target_content == 'W' || target_content == 'M') {
-                    new_x = j - 1; // stop before colision
-                    result = VALID_MOVE;
-                    break;
-                }
-                else if (target_content == 'P') {
-                    new_x = j;
-                    result = find_and_kill_pacman(board, new_x, new_y);
-                    break;
-                }
-            }
-
-            for (int j = x; j < board->width; j++) {
-                pthread_mutex_unlock(&board->board[y * board->width + j].lock);
-            }
+            result = charge_ghost_path(board, x, y, 1, 0, &new_x, &new_y);
             break;
         default:
             debug("DEFAULT CHARGED MOVE - direction = %c\n", direction);
             return INVALID_MOVE;
     }
 
-    board->board[y * board->width + x].content = ' '; // Or restore the dot if ghost was on one
+    board->content[get_board_index(board, x, y)] = ' '; // Or restore the dot if ghost was on one
+    set_occupant(board, get_board_index(board, x, y), 0);
 
     // Update ghost position
     ghost->pos_x = new_x;
     ghost->pos_y = new_y;
 
     // Update board - set new position
-    board->board[new_y * board->width + new_x].content = 'M';
+    board->content[get_board_index(board, new_x, new_y)] = 'M';
+    set_occupant(board, get_board_index(board, new_x, new_y), ghost_index + 1);
     return result;
 }
 
@@ -321,7 +217,7 @@ int move_ghost(board_t* board, int ghost_index, command_t* command) {
 
     if (direction == 'R') {
         char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
+        direction = directions[rand_r(&board->rng_state) % 4];
     }
 
     // Calculate new position based on direction
@@ -364,74 +260,59 @@ int move_ghost(board_t* board, int ghost_index, command_t* command) {
     }
 
     // Check board position
-    int new_index = new_y * board->width + new_x;
-    int old_index = ghost->pos_y * board->width + ghost->pos_x;
-
-    // locks
-    if (old_index < new_index) {
-        pthread_mutex_lock(&board->board[old_index].lock);
-        pthread_mutex_lock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_lock(&board->board[new_index].lock);
-        pthread_mutex_lock(&board->board[old_index].lock);
-    }
-
-    char target_content = board->board[new_index].content;
+    int new_index = get_board_index(board, new_x, new_y);
+    int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
 
-    // Check for walls
-    if (target_content == 'W') {
-        goto move_ghost_invalid;
-    }
+    char target_content = board->content[new_index];
 
-    // Check for ghosts
-    if (target_content == 'M') {
-        goto move_ghost_invalid;
+    // Check for walls and ghosts
+    if (target_content == 'W' || target_content == 'M') {
+        return INVALID_MOVE;
     }
 
     int result = VALID_MOVE;
     // Check for pacman
     if (target_content == 'P') {
-        for (int i = 0; i < board->n_pacmans; i++) {
-            pacman_t* pac = &board->pacmans[i];
-            if (pac->pos_x == new_x && pac->pos_y == new_y && pac->alive) {
-                pac->alive = 0; // Pacman dies
-                kill_pacman(board, i);
-                result = DEAD_PACMAN;
-                break;
-            }
-        }
+        result = find_and_kill_pacman(board, new_x, new_y);
     }
 
     // Update board - clear old position (restore what was there)
-    board->board[old_index].content = ' '; // Or restore the dot if ghost was on one
+    board->content[old_index] = ' '; // Or restore the dot if ghost was on one
+    set_occupant(board, old_index, 0);
     // Update ghost position
     ghost->pos_x = new_x;
     ghost->pos_y = new_y;
     // Update board - set new position
-    board->board[new_index].content = 'M';
+    board->content[new_index] = 'M';
+    set_occupant(board, new_index, ghost_index + 1);
 
-    if (old_index < new_index) {
-        pthread_mutex_unlock(&board->board[old_index].lock);
-        pthread_mutex_unlock(&board->board[new_index].lock);
-    }
-    else {
-        pthread_mutex_unlock(&board->board[new_index].lock);
-        pthread_mutex_unlock(&board->board[old_index].lock);
-    }
-    
     return result;
+}
+
+int board_step(board_t* board, const board_inputs_t* inputs) {
+    pacman_t* pac = &board->pacmans[0];
 
-    move_ghost_invalid:
-    if (old_index < new_index) {
-        pthread_mutex_unlock(&board->board[old_index].lock);
-        pthread_mutex_unlock(&board->board[new_index].lock);
+    for (int i = 0; inputs && i < inputs->n_moves; i++) {
+        command_t cmd = {inputs->moves[i], 1, 1};
+        // Player input is not rate limited by the pacman's passo
+        pac->passo = 0;
+        pac->waiting = 0;
+
+        int result = move_pacman(board, 0, &cmd);
+        if (result == REACHED_PORTAL || result == DEAD_PACMAN) return result;
     }
-    else {
-        pthread_mutex_unlock(&board->board[new_index].lock);
-        pthread_mutex_unlock(&board->board[old_index].lock);
+
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        command_t random_cmd = {'R', 0, 0};
+        command_t* cmd = &random_cmd;
+        if (ghost->n_moves > 0) {
+            cmd = &ghost->moves[ghost->current_move % ghost->n_moves];
+        }
+        move_ghost(board, g, cmd);
     }
-    return INVALID_MOVE;
+
+    return pac->alive ? VALID_MOVE : DEAD_PACMAN;
 }
 
 void kill_pacman(board_t* board, int pacman_index) {
@@ -440,7 +321,8 @@ void kill_pacman(board_t* board, int pacman_index) {
     int index = pac->pos_y * board->width + pac->pos_x;
 
     // Remove pacman from the board
-    board->board[index].content = ' ';
+    board->content[index] = ' ';
+    set_occupant(board, index, 0);
 
     // Mark pacman as dead
     pac->alive = 0;
@@ -448,7 +330,7 @@ void kill_pacman(board_t* board, int pacman_index) {
 
 // Static Loading
 int load_pacman(board_t* board) {
-    board->board[1 * board->width + 1].content = 'P'; // Pacman
+    board->content[1 * board->width + 1] = 'P'; // Pacman
     board->pacmans[0].pos_x = 1;
     board->pacmans[0].pos_y = 1;
     board->pacmans[0].alive = 1;
@@ -458,34 +340,77 @@ int load_pacman(board_t* board) {
 
 // Static Loading
 int load_ghost(board_t* board) {
-    board->board[4 * board->width + 8].content = 'M'; // Monster
+    board->content[4 * board->width + 8] = 'M'; // Monster
     board->ghosts[0].pos_x = 8;
     board->ghosts[0].pos_y = 4;
-    board->board[0 * board->width + 5].content = 'M'; // Monster
+    board->content[0 * board->width + 5] = 'M'; // Monster
     board->ghosts[1].pos_x = 5;
     board->ghosts[1].pos_y = 0;
     return 0;
 }
 
+// Tries dirname/<level>.lvlb, compiled by levelc. Returns -1 to fall back to the text files
+static int load_level_binary(board_t *board, char *filename, char* dirname, int points) {
+    char path[MAX_FILENAME * 2];
+    const char* dot = strrchr(filename, '.');
+    int name_len = dot ? (int)(dot - filename) : (int)strlen(filename);
+    snprintf(path, sizeof(path), "%s/%.*s%s", dirname, name_len, filename, LEVELB_EXTENSION);
+
+    if (read_level_binary(board, path) < 0) return -1;
+
+    snprintf(board->level_name, sizeof(board->level_name), "%.*s", name_len, filename);
+    board->pacmans[0].points = points;
+    return 0;
+}
+
 int load_level(board_t *board, char *filename, char* dirname, int points) {
 
-    if (read_level(board, filename, dirname) < 0) {
-        printf("Failed to load level\n");
-        return -1;
-    }
+    if (load_level_binary(board, filename, dirname, points) < 0) {
+        if (read_level(board, filename, dirname) < 0) {
+            printf("Failed to load level\n");
+            return -1;
+        }
 
-    if (read_pacman(board, points) < 0) {
-        printf("Failed to load the pacman\n");
-    }
+        if (read_pacman(board, points) < 0) {
+            printf("Failed to load the pacman\n");
+        }
 
-    if (read_ghosts(board) < 0) {
-        printf("Failed to read ghosts\n");
-    }
+        if (read_ghosts(board) < 0) {
+            printf("Failed to read ghosts\n");
+        }
 
-    pthread_rwlock_init(&board->state_lock, NULL);
+        // Same rule as the .lvlb loader: every spawn must be on the board
+        for (int p = 0; p < board->n_pacmans; p++) {
+            if (!is_valid_position(board, board->pacmans[p].pos_x, board->pacmans[p].pos_y)) {
+                printf("Pacman outside the board\n");
+                return -1;
+            }
+        }
+        for (int g = 0; g < board->n_ghosts; g++) {
+            if (!is_valid_position(board, board->ghosts[g].pos_x, board->ghosts[g].pos_y)) {
+                printf("Ghost %d outside the board\n", g);
+                return -1;
+            }
+        }
+    }
 
-    for (int i = 0; i < board->height * board->width; i++) {
-        pthread_mutex_init(&board->board[i].lock, NULL);
+    // Occupancy index, built from the entity positions the parser placed
+    board->occupant = calloc(board->width * board->height, sizeof(int));
+    if (!board->occupant) {
+        printf("Failed to allocate the occupancy index\n");
+        return -1;
+    }
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        if (pac->alive && is_valid_position(board, pac->pos_x, pac->pos_y)) {
+            set_occupant(board, get_board_index(board, pac->pos_x, pac->pos_y), -(p + 1));
+        }
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        if (is_valid_position(board, ghost->pos_x, ghost->pos_y)) {
+            set_occupant(board, get_board_index(board, ghost->pos_x, ghost->pos_y), g + 1);
+        }
     }
 
     //print_board(board);
@@ -493,77 +418,75 @@ int load_level(board_t *board, char *filename, char* dirname, int points) {
 }
 
 void unload_level(board_t * board) {
-    pthread_rwlock_destroy(&board->state_lock);
-    for (int i = 0; i < board->height * board->width; i++) {
-        pthread_mutex_destroy(&board->board[i].lock);
-    }
-    free(board->board);
+    free(board->content);
+    free(board->dots);
+    free(board->portals);
+    free(board->occupant);
     free(board->pacmans);
     free(board->ghosts);
 }
 
-// Does exaclty the same as draw board but stores the output in a string instead of printing it
-char* get_board_displayed(board_t* board) {
-    size_t buffer_size = (board->width  * board->height) + 1;
-    char* output = malloc(buffer_size);
-    size_t pos = 0;
-    for (int y = 0; y < board->height; y++) {
-        for (int x = 0; x < board->width; x++) {
-            int index = y * board->width + x;
-            char ch = board->board[index].content;
-            int ghost_charged = 0;
-
-            for (int g = 0; g < board->n_ghosts; g++) {
-                ghost_t* ghost = &board->ghosts[g];
-                if (ghost->pos_x == x && ghost->pos_y == y) {
-                    if (ghost->charged)
-                        ghost_charged = 1;
-                    break;
-                }
+// The character the client sees for one cell
+static inline char render_cell(board_t* board, int index) {
+    char ch = board->content[index];
+
+    // Draw with appropriate character
+    switch (ch) {
+        case 'W': // Wall
+            return '#';
+
+        case 'P': // Pacman
+            return 'C';
+
+        case 'M': { // Monster/Ghost
+            int g = board->occupant[index] - 1;
+            if (g >= 0 && board->ghosts[g].charged) {
+                return 'G';
             }
+            return 'M';
+        }
 
-            // Draw with appropriate character
-            switch (ch) {
-                case 'W': // Wall
-                    output[pos++] = '#';
-                    break;
-
-                case 'P': // Pacman
-                    output[pos++] = 'C';
-                    break;
-
-                case 'M': // Monster/Ghost
-                    if (ghost_charged) {
-                        output[pos++] = 'G'; 
-                    } else {
-                        output[pos++] = 'M';
-                    }
-                    break;
-
-                case ' ': // Empty space
-                    if (board->board[index].has_portal) {
-                        output[pos++] = '@';
-                    }
-                    else if (board->board[index].has_dot) {
-                        output[pos++] = '.';
-                    }
-                    else
-                        output[pos++] = ' ';
-                    break;
-
-                default:
-                    output[pos++] = ch;
-                    break;
+        case ' ': // Empty space
+            if (bitplane_get(board->portals, index)) {
+                return '@';
+            }
+            if (bitplane_get(board->dots, index)) {
+                return '.';
             }
+            return ' ';
+
+        default:
+            return ch;
+    }
+}
+
+void render_board(board_t* board, char* output) {
+    int size = board->width * board->height;
+    for (int index = 0; index < size; index++) {
+        output[index] = render_cell(board, index);
+    }
+}
+
+void render_board_window(board_t* board, int x, int y, int width, int height, char* output) {
+    for (int row = 0; row < height; row++) {
+        int index = (y + row) * board->width + x;
+        for (int col = 0; col < width; col++) {
+            *output++ = render_cell(board, index + col);
         }
     }
-    
-    output[pos] = '\0';
+}
+
+// Does exaclty the same as draw board but stores the output in a string instead of printing it
+char* get_board_displayed(board_t* board) {
+    size_t buffer_size = (board->width  * board->height) + 1;
+    char* output = malloc(buffer_size);
+    render_board(board, output);
+    output[buffer_size - 1] = '\0';
     return output;
 }
 
 void print_board(board_t *board) {
-    if (!board || !board->board) {
+    if (!board || !board->content) {
         debug("[%d] Board is empty or not initialized.\n", getpid());
         return;
     }
@@ -593,7 +516,7 @@ void print_board(board_t *board) {
         for (int x = 0; x < board->width; x++) {
             int idx = y * board->width + x;
             if (offset < sizeof(buffer) - 2) {
-                buffer[offset++] = board->board[idx].content;
+                buffer[offset++] = board->content[idx];
             }
         }
         if (offset < sizeof(buffer) - 2) {
@@ -1,26 +1,219 @@
 #include <stdlib.h>
 #include <stdio.h> //snprintf
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include "debug.h"
+
+#define LOG_RING_SLOTS 1024         // messages buffered per thread before new ones are dropped
+#define LOG_MESSAGE_SIZE 240        // longer messages are truncated
+#define LOG_FLUSH_INTERVAL_MS 5
 
 FILE * debugfile=NULL;
+int log_runtime_level = LOG_LEVEL_DEBUG;
 
-void open_debug_file(char *filename) {
-    debugfile = fopen(filename, "w");
+typedef struct {
+    long long timestamp_ns;
+    int length;
+    char text[LOG_MESSAGE_SIZE];
+} log_record_t;
+
+// Single producer (the owning thread), single consumer (whoever holds drain_lock)
+typedef struct log_ring {
+    log_record_t records[LOG_RING_SLOTS];
+    unsigned long long head;        // only the owner stores it
+    unsigned long long tail;        // only the consumer stores it
+    unsigned long long drained_to;  // consumer only: head seen by the drain in progress
+    unsigned long long dropped;
+    int in_use;                     // a thread owns the ring; released when the thread exits
+    struct log_ring* next;          // push-only list of every ring ever created
+} log_ring_t;
+
+static log_ring_t* rings = NULL;
+static _Thread_local log_ring_t* thread_ring = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static int writer_running = 0;
+static pthread_t writer_tid;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_record_t** batch = NULL;
+static size_t batch_capacity = 0;
+
+static void release_ring(void* ring) {
+    __atomic_store_n(&((log_ring_t*)ring)->in_use, 0, __ATOMIC_RELEASE);
 }
 
-void close_debug_file() {
-    fclose(debugfile);
+static void create_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// Reuses a ring left by a thread that exited, or pushes a new one onto the list
+static log_ring_t* acquire_ring(void) {
+    pthread_once(&ring_key_once, create_ring_key);
+
+    log_ring_t* ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+    }
+
+    if (ring == NULL) {
+        ring = calloc(1, sizeof(log_ring_t));
+        if (ring == NULL) return NULL;
+        ring->in_use = 1;
+        ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    pthread_setspecific(ring_key, ring);
+    thread_ring = ring;
+    return ring;
 }
 
-void debug(const char * format, ...) {
+void log_write(int level, const char * format, ...) {
+    (void)level;
+    if (!__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) return;
+
+    log_ring_t* ring = thread_ring ? thread_ring : acquire_ring();
+    if (ring == NULL) return;
+
+    unsigned long long head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SLOTS) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    log_record_t* record = &ring->records[head % LOG_RING_SLOTS];
+    record->timestamp_ns = current_time_ns();
     va_list args;
     va_start(args, format);
-    vfprintf(debugfile, format, args);
+    int n = vsnprintf(record->text, LOG_MESSAGE_SIZE, format, args);
     va_end(args);
+    if (n < 0) n = 0;
+    if (n >= LOG_MESSAGE_SIZE) {
+        n = LOG_MESSAGE_SIZE - 1;
+        record->text[n - 1] = '\n'; // truncated, but still one line
+    }
+    record->length = n;
 
-    fflush(debugfile);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static int compare_records(const void* a, const void* b) {
+    long long ta = (*(log_record_t* const*)a)->timestamp_ns;
+    long long tb = (*(log_record_t* const*)b)->timestamp_ns;
+    return (ta > tb) - (ta < tb);
+}
+
+// Writes every published record, merged across threads by timestamp, with a single flush.
+// Caller holds drain_lock.
+static void drain_locked(void) {
+    size_t n = 0;
+    unsigned long long dropped = 0;
+    for (log_ring_t* ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long long tail = ring->tail;
+        if (n + (head - tail) > batch_capacity) {
+            size_t capacity = batch_capacity ? batch_capacity * 2 : LOG_RING_SLOTS;
+            while (capacity < n + (head - tail)) capacity *= 2;
+            log_record_t** grown = realloc(batch, capacity * sizeof(log_record_t*));
+            if (grown == NULL) head = tail; // try again on the next drain
+            else {
+                batch = grown;
+                batch_capacity = capacity;
+            }
+        }
+        for (; tail < head; tail++) batch[n++] = &ring->records[tail % LOG_RING_SLOTS];
+        ring->drained_to = head;
+        dropped += __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    }
+
+    qsort(batch, n, sizeof(log_record_t*), compare_records);
+    for (size_t i = 0; i < n; i++) fwrite(batch[i]->text, 1, batch[i]->length, debugfile);
+    if (dropped > 0) fprintf(debugfile, "[log] %llu mensagens perdidas (buffer cheio)\n", dropped);
+    if (n > 0 || dropped > 0) fflush(debugfile);
+
+    // Only now can the producers reuse the slots
+    for (log_ring_t* ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        __atomic_store_n(&ring->tail, ring->drained_to, __ATOMIC_RELEASE);
+    }
+}
+
+static void drain_rings(void) {
+    pthread_mutex_lock(&drain_lock);
+    drain_locked();
+    pthread_mutex_unlock(&drain_lock);
+}
+
+static void* log_writer_thread(void* arg) {
+    (void)arg;
+    while (__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+        drain_rings();
+        sleep_ms(LOG_FLUSH_INTERVAL_MS);
+    }
+    return NULL;
+}
+
+// Normal shutdown goes through close_debug_file (the server's signal handlers only set a flag
+// and main drains the log after its cleanup). This covers exit() and returns from main that
+// skip it, e.g. the server's startup failures.
+// trylock: the writer thread may still be in the middle of a drain when exit() runs.
+static void flush_at_exit(void) {
+    if (debugfile == NULL || pthread_mutex_trylock(&drain_lock) != 0) return;
+    drain_locked();
+    pthread_mutex_unlock(&drain_lock);
+}
+
+static int parse_level(const char* value) {
+    const char* names[] = {"error", "warn", "info", "debug"};
+    for (int i = 0; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcasecmp(value, names[i]) == 0) return i;
+    }
+    if (value[0] >= '0' && value[0] <= '9') return atoi(value);
+    return -1;
+}
+
+void log_set_level(int level) {
+    __atomic_store_n(&log_runtime_level, level, __ATOMIC_RELAXED);
+}
+
+void open_debug_file(char *filename) {
+    debugfile = fopen(filename, "w");
+    if (debugfile == NULL) return;
+
+    const char* env = getenv("PACMAN_LOG_LEVEL");
+    if (env && parse_level(env) >= 0) log_set_level(parse_level(env));
+
+    static int atexit_registered = 0;
+    if (!atexit_registered) {
+        atexit(flush_at_exit);
+        atexit_registered = 1;
+    }
+
+    // The writer never handles signals, they stay with the threads that expect them
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    __atomic_store_n(&writer_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&writer_tid, NULL, log_writer_thread, NULL) != 0) {
+        __atomic_store_n(&writer_running, 0, __ATOMIC_RELEASE);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+void close_debug_file() {
+    if (debugfile == NULL) return;
+    if (__atomic_exchange_n(&writer_running, 0, __ATOMIC_ACQ_REL)) {
+        pthread_join(writer_tid, NULL);
+    }
+    drain_rings();
+    fclose(debugfile);
+    debugfile = NULL;
 }
 
 void sleep_ms(int milliseconds) {
@@ -28,4 +221,16 @@ void sleep_ms(int milliseconds) {
     ts.tv_sec = milliseconds / 1000;
     ts.tv_nsec = (milliseconds % 1000) * 1000000;
     nanosleep(&ts, NULL);
-}
\ No newline at end of file
+}
+
+long long current_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long current_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
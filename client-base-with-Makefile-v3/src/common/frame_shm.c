@@ -0,0 +1,150 @@
+#define _DEFAULT_SOURCE // syscall()
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "frame_shm.h"
+#include "debug.h"
+
+// Sem FUTEX_PRIVATE_FLAG: a palavra é partilhada entre processos
+static void futex_wait(unsigned int* addr, unsigned int expected, int timeout_ms) {
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000};
+    syscall(SYS_futex, addr, FUTEX_WAIT, expected, &ts, NULL, 0);
+}
+
+static void futex_wake(unsigned int* addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+void frame_shm_name(const char* notif_path, char* name) {
+    const char* base = strrchr(notif_path, '/');
+    base = base ? base + 1 : notif_path;
+    snprintf(name, FRAME_SHM_NAME_LENGTH, "/pacman_%s", base);
+}
+
+size_t frame_shm_size(const frame_shm_t* shm) {
+    return sizeof(frame_shm_t) + 2 * (size_t)shm->capacity;
+}
+
+char* frame_shm_cells(frame_shm_t* shm, int slot) {
+    return shm->cells + (size_t)slot * shm->capacity;
+}
+
+frame_shm_t* frame_shm_create(const char* name, int capacity) {
+    shm_unlink(name); // restos de uma sessão anterior com o mesmo pipe
+    // Só o dono: outro utilizador local podia injetar tabuleiros ou estragar o seqlock/futex
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return NULL;
+
+    size_t size = sizeof(frame_shm_t) + 2 * (size_t)capacity;
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    frame_shm_t* shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+    // ftruncate já deixou tudo a zeros: nenhum tabuleiro publicado
+    shm->capacity = capacity;
+    return shm;
+}
+
+frame_shm_t* frame_shm_open(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+    shm_unlink(name); // já está mapeado pelos dois lados; o nome deixa de ser preciso
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(frame_shm_t)) {
+        close(fd);
+        return NULL;
+    }
+    frame_shm_t* shm = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) return NULL;
+
+    if (shm->capacity < 0 || frame_shm_size(shm) > (size_t)st.st_size) {
+        munmap(shm, st.st_size);
+        return NULL;
+    }
+    return shm;
+}
+
+void frame_shm_unmap(frame_shm_t* shm) {
+    if (shm) munmap(shm, frame_shm_size(shm));
+}
+
+int frame_shm_write_begin(frame_shm_t* shm) {
+    // Só há um escritor: published não muda entre begin e end
+    int slot = (shm->published + 1) & 1;
+    frame_shm_slot_t* s = &shm->slots[slot];
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return slot;
+}
+
+void frame_shm_write_end(frame_shm_t* shm, int slot) {
+    frame_shm_slot_t* s = &shm->slots[slot];
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->published, shm->published + 1, __ATOMIC_RELEASE);
+    // seq_cst aqui e no leitor: ou o leitor vê o evento novo, ou o escritor vê o leitor à espera
+    __atomic_fetch_add(&shm->events, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shm->waiters, __ATOMIC_SEQ_CST)) futex_wake(&shm->events);
+}
+
+void frame_shm_close(frame_shm_t* shm) {
+    __atomic_store_n(&shm->closed, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&shm->events, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&shm->events);
+}
+
+int frame_shm_read(frame_shm_t* shm, unsigned int* seq, frame_header_t* header, char* cells, int timeout_ms) {
+    long long deadline = current_time_ms() + timeout_ms;
+
+    while (1) {
+        // Lido antes do estado: uma mudança depois disto faz o futex_wait regressar logo
+        unsigned int events = __atomic_load_n(&shm->events, __ATOMIC_SEQ_CST);
+
+        unsigned int published = __atomic_load_n(&shm->published, __ATOMIC_ACQUIRE);
+        if (published != *seq) {
+            // Ímpar: o servidor já está a reescrever este buffer e o evento do fim da escrita acorda-nos
+            frame_shm_slot_t* slot = &shm->slots[published & 1];
+            unsigned int s = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if ((s & 1) == 0) {
+                memcpy(header, &slot->header, sizeof(frame_header_t));
+                int size = header->width * header->height;
+                if (size >= 0 && size <= shm->capacity) memcpy(cells, frame_shm_cells(shm, published & 1), size);
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                // Se o servidor voltou a este buffer entretanto, a cópia pode estar misturada: repete
+                if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != s ||
+                    __atomic_load_n(&shm->published, __ATOMIC_RELAXED) - published >= 2) {
+                    continue;
+                }
+                if (size < 0 || size > shm->capacity) return -1;
+                *seq = published;
+                return 1;
+            }
+        }
+
+        // Os tabuleiros publicados antes do fecho ainda são lidos
+        if (__atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE)) return -1;
+
+        int remaining = (int)(deadline - current_time_ms());
+        if (remaining <= 0) return 0;
+
+        __atomic_store_n(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shm->events, __ATOMIC_SEQ_CST) == events) {
+            futex_wait(&shm->events, events, remaining);
+        }
+        __atomic_store_n(&shm->waiters, 0, __ATOMIC_RELAXED);
+    }
+}
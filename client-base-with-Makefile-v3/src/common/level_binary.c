@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "level_binary.h"
+#include "debug.h"
+
+static void pack_entity(levelb_entity_t* out, int x, int y, int passo, const command_t* moves, int n_moves,
+                        const char* source) {
+    memset(out, 0, sizeof(*out));
+    // The parser keeps "<dir>/<file>"; only the name is stored, the directory is the .lvlb's
+    const char* name = strrchr(source, '/');
+    snprintf(out->source, sizeof(out->source), "%s", name ? name + 1 : source);
+    out->pos_x = x;
+    out->pos_y = y;
+    out->passo = passo;
+    out->n_moves = n_moves;
+    for (int m = 0; m < n_moves && m < MAX_MOVES; m++) {
+        out->moves[m].command = moves[m].command;
+        out->moves[m].turns = moves[m].turns;
+    }
+}
+
+int write_level_binary(board_t* board, const char* path) {
+    int n_cells = board->width * board->height;
+    uint32_t plane_bytes = BITPLANE_BYTES(n_cells);
+
+    levelb_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVELB_MAGIC, 4);
+    header.version = LEVELB_VERSION;
+    header.width = board->width;
+    header.height = board->height;
+    header.tempo = board->tempo;
+    header.n_pacmans = board->n_pacmans;
+    header.n_ghosts = board->n_ghosts;
+    header.entities_offset = sizeof(header);
+    header.walls_offset = header.entities_offset + (board->n_pacmans + board->n_ghosts) * sizeof(levelb_entity_t);
+    header.dots_offset = header.walls_offset + plane_bytes;
+    header.portals_offset = header.dots_offset + plane_bytes;
+    header.file_size = header.portals_offset + plane_bytes;
+
+    unsigned char* walls = calloc(plane_bytes, 1);
+    if (!walls) return -1;
+    for (int i = 0; i < n_cells; i++) {
+        if (board->content[i] == 'W') bitplane_set(walls, i, 1);
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        free(walls);
+        return -1;
+    }
+
+    fwrite(&header, sizeof(header), 1, f);
+    for (int p = 0; p < board->n_pacmans; p++) {
+        levelb_entity_t entity;
+        pacman_t* pac = &board->pacmans[p];
+        pack_entity(&entity, pac->pos_x, pac->pos_y, pac->passo, pac->moves, pac->n_moves, board->pacman_file);
+        fwrite(&entity, sizeof(entity), 1, f);
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        levelb_entity_t entity;
+        ghost_t* ghost = &board->ghosts[g];
+        pack_entity(&entity, ghost->pos_x, ghost->pos_y, ghost->passo, ghost->moves, ghost->n_moves,
+                    board->ghosts_files[g]);
+        fwrite(&entity, sizeof(entity), 1, f);
+    }
+    fwrite(walls, plane_bytes, 1, f);
+    fwrite(board->dots, plane_bytes, 1, f);
+    fwrite(board->portals, plane_bytes, 1, f);
+
+    free(walls);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static void place_entity(board_t* board, int x, int y, char symbol) {
+    if (x >= 0 && x < board->width && y >= 0 && y < board->height) {
+        board->content[y * board->width + x] = symbol;
+    }
+}
+
+static void unpack_moves(command_t* moves, const levelb_entity_t* entity) {
+    for (int m = 0; m < entity->n_moves && m < MAX_MOVES; m++) {
+        moves[m].command = entity->moves[m].command;
+        moves[m].turns = entity->moves[m].turns;
+        moves[m].turns_left = moves[m].command == 'T' ? moves[m].turns : 0;
+    }
+}
+
+// True if dir/name was modified after the .lvlb was written (or can no longer be read)
+static int source_is_newer(const char* dir, int dir_len, const char* name, const struct stat* compiled) {
+    char source_path[MAX_FILENAME * 2];
+    struct stat st;
+    snprintf(source_path, sizeof(source_path), "%.*s%s", dir_len, dir, name);
+    if (stat(source_path, &st) < 0) return 1;
+    if (st.st_mtim.tv_sec != compiled->st_mtim.tv_sec) return st.st_mtim.tv_sec > compiled->st_mtim.tv_sec;
+    return st.st_mtim.tv_nsec > compiled->st_mtim.tv_nsec;
+}
+
+// The .lvl next to the .lvlb and every .p/.m named in its entities must be older than it
+static int is_stale(const char* path, const struct stat* compiled, const levelb_entity_t* entities, int n_entities) {
+    const char* slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path) + 1 : 0;
+
+    char level_file[MAX_FILENAME];
+    int ext_len = (int)strlen(LEVELB_EXTENSION);
+    int name_len = (int)strlen(path) - dir_len - ext_len;
+    if (name_len < 0) return 1;
+    snprintf(level_file, sizeof(level_file), "%.*s.lvl", name_len, path + dir_len);
+    if (source_is_newer(path, dir_len, level_file, compiled)) return 1;
+
+    for (int i = 0; i < n_entities; i++) {
+        if (entities[i].source[0] == '\0') continue;
+        if (memchr(entities[i].source, '\0', sizeof(entities[i].source)) == NULL) return 1;
+        if (source_is_newer(path, dir_len, entities[i].source, compiled)) return 1;
+    }
+    return 0;
+}
+
+// A plane (or the entity table) that starts at offset must end inside the file
+static int section_fits(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+// Everything read_level_binary dereferences must lie inside the mapping
+static int header_is_valid(const levelb_header_t* header, off_t file_size) {
+    if (memcmp(header->magic, LEVELB_MAGIC, 4) != 0 || header->version != LEVELB_VERSION ||
+        header->width <= 0 || header->height <= 0 || header->n_pacmans != 1 ||
+        header->n_ghosts < 0 || header->n_ghosts > MAX_GHOSTS ||
+        header->file_size != (uint64_t)file_size) {
+        return 0;
+    }
+    if ((int64_t)header->width * header->height > INT_MAX - 7) return 0; // BITPLANE_BYTES in int
+
+    uint64_t plane_bytes = BITPLANE_BYTES((uint64_t)header->width * header->height);
+    uint64_t entities_bytes = (uint64_t)(header->n_pacmans + header->n_ghosts) * sizeof(levelb_entity_t);
+    return header->entities_offset >= sizeof(levelb_header_t) &&
+           section_fits(header->entities_offset, entities_bytes, header->file_size) &&
+           section_fits(header->walls_offset, plane_bytes, header->file_size) &&
+           section_fits(header->dots_offset, plane_bytes, header->file_size) &&
+           section_fits(header->portals_offset, plane_bytes, header->file_size);
+}
+
+// Undoes a partial load; the pointers are cleared so a later unload_level is harmless
+static void free_planes(board_t* board) {
+    free(board->content);
+    free(board->dots);
+    free(board->portals);
+    free(board->pacmans);
+    free(board->ghosts);
+    board->content = NULL;
+    board->dots = board->portals = NULL;
+    board->pacmans = NULL;
+    board->ghosts = NULL;
+}
+
+// Every spawn must be on the board: the first move indexes content[] and occupant[] with it
+static int entities_are_valid(const levelb_header_t* header, const levelb_entity_t* entities) {
+    for (int i = 0; i < header->n_pacmans + header->n_ghosts; i++) {
+        if (entities[i].pos_x < 0 || entities[i].pos_x >= header->width ||
+            entities[i].pos_y < 0 || entities[i].pos_y >= header->height) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int read_level_binary(board_t* board, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(levelb_header_t)) {
+        close(fd);
+        return -1;
+    }
+
+    const unsigned char* file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) return -1;
+
+    const levelb_header_t* header = (const levelb_header_t*)file;
+    if (!header_is_valid(header, st.st_size)) {
+        debug("Invalid level file %s\n", path);
+        munmap((void*)file, st.st_size);
+        return -1;
+    }
+
+    const levelb_entity_t* entities = (const levelb_entity_t*)(file + header->entities_offset);
+    if (!entities_are_valid(header, entities)) {
+        debug("Invalid level file %s: entity outside the board\n", path);
+        munmap((void*)file, st.st_size);
+        return -1;
+    }
+    if (is_stale(path, &st, entities, header->n_pacmans + header->n_ghosts)) {
+        debug("Stale level file %s, using the text files\n", path);
+        munmap((void*)file, st.st_size);
+        return -1;
+    }
+
+    int n_cells = header->width * header->height;
+    uint32_t plane_bytes = BITPLANE_BYTES(n_cells);
+
+    board->width = header->width;
+    board->height = header->height;
+    board->tempo = header->tempo;
+    board->n_pacmans = header->n_pacmans;
+    board->n_ghosts = header->n_ghosts;
+    board->pacman_file[0] = '\0';
+
+    board->content = malloc(n_cells);
+    board->dots = malloc(plane_bytes);
+    board->portals = malloc(plane_bytes);
+    board->pacmans = calloc(board->n_pacmans, sizeof(pacman_t));
+    board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    if (!board->content || !board->dots || !board->portals || !board->pacmans ||
+        (board->n_ghosts > 0 && !board->ghosts)) {
+        free_planes(board);
+        munmap((void*)file, st.st_size);
+        return -1;
+    }
+
+    memcpy(board->dots, file + header->dots_offset, plane_bytes);
+    memcpy(board->portals, file + header->portals_offset, plane_bytes);
+    const unsigned char* walls = file + header->walls_offset;
+    for (int i = 0; i < n_cells; i++) {
+        board->content[i] = bitplane_get(walls, i) ? 'W' : ' ';
+    }
+
+    pacman_t* pac = &board->pacmans[0];
+    pac->pos_x = entities[0].pos_x;
+    pac->pos_y = entities[0].pos_y;
+    pac->passo = pac->waiting = entities[0].passo;
+    pac->alive = 1;
+    place_entity(board, pac->pos_x, pac->pos_y, 'P');
+
+    for (int g = 0; g < board->n_ghosts; g++) {
+        const levelb_entity_t* entity = &entities[board->n_pacmans + g];
+        ghost_t* ghost = &board->ghosts[g];
+        ghost->pos_x = entity->pos_x;
+        ghost->pos_y = entity->pos_y;
+        ghost->passo = ghost->waiting = entity->passo;
+        ghost->n_moves = entity->n_moves < 0 ? 0 : entity->n_moves < MAX_MOVES ? entity->n_moves : MAX_MOVES;
+        unpack_moves(ghost->moves, entity);
+        place_entity(board, ghost->pos_x, ghost->pos_y, 'M');
+    }
+
+    munmap((void*)file, st.st_size);
+    return 0;
+}
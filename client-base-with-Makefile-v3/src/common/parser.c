@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include "parser.h"
 #include "board.h"
 #include <fcntl.h>
@@ -20,7 +21,12 @@ int read_level(board_t* board, char* filename, char* dirname) {
         return -1;
     }
     
-    char command[MAX_COMMAND_LENGTH];
+    line_reader_t reader;
+    if (line_reader_open(&reader, fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    char* command;
 
     // Pacman is optional
     board->pacman_file[0] = '\0';
@@ -30,7 +36,7 @@ int read_level(board_t* board, char* filename, char* dirname) {
     *strrchr(board->level_name, '.') = '\0';
 
     int read;
-    while ((read = read_line(fd, command)) > 0) {
+    while ((read = line_reader_next(&reader, &command)) > 0) {
 
         // comment
         if (command[0] == '#' || command[0] == '\0') continue;
@@ -83,46 +89,63 @@ int read_level(board_t* board, char* filename, char* dirname) {
 
     if (!board->width || !board->height) {
         debug("Missing dimensions in level file\n");
+        line_reader_close(&reader);
         close(fd);
         return -1;
     }
     
     // the end of the file contains the grid
-    board->board = calloc(board->width * board->height, sizeof(board_pos_t));
+    int n_cells = board->width * board->height;
+    board->content = calloc(n_cells, sizeof(char));
+    board->dots = calloc(BITPLANE_BYTES(n_cells), 1);
+    board->portals = calloc(BITPLANE_BYTES(n_cells), 1);
     board->pacmans = calloc(board->n_pacmans, sizeof(pacman_t));
     board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    if (!board->content || !board->dots || !board->portals || !board->pacmans ||
+        (board->n_ghosts > 0 && !board->ghosts)) {
+        // whatever was allocated is freed by the caller's unload_level
+        debug("Out of memory loading level %s\n", filename);
+        line_reader_close(&reader);
+        close(fd);
+        return -1;
+    }
 
     int row = 0;
     // command here still holds the previous line
     while (read > 0) {
-        if (command[0]== '#' || command[0] == '\0') continue;
+        if (command[0]== '#' || command[0] == '\0') {
+            read = line_reader_next(&reader, &command);
+            continue;
+        }
         if (row >= board->height) break;
 
         debug("Line: %s\n", command);
 
+        int len = strlen(command);
         for (int col = 0; col < board -> width; col++){
             int idx = row * board->width + col;
-            char content = command[col];
+            char content = col < len ? command[col] : ' ';
 
             switch (content) {
                 case 'X': // wall
-                    board->board[idx].content = 'W';
+                    board->content[idx] = 'W';
                     break;
                 case '@': // portal
-                    board->board[idx].content = ' ';
-                    board->board[idx].has_portal = 1;
+                    board->content[idx] = ' ';
+                    bitplane_set(board->portals, idx, 1);
                     break;
                 default:
-                    board->board[idx].content = ' ';
-                    board->board[idx].has_dot = 1;
+                    board->content[idx] = ' ';
+                    bitplane_set(board->dots, idx, 1);
                     break;
             }
         }
 
         row++;
-        read = read_line(fd, command);
+        read = line_reader_next(&reader, &command);
     }
 
+    line_reader_close(&reader);
     if (read == -1) {
       debug("Failed parsing line");
       close(fd);
@@ -150,10 +173,10 @@ int read_pacman(board_t* board, int points) {
         for (int i = 0; i < board->height; i++) {
             for (int j = 0; j < board->width; j++) {
                 int idx = i * board->width + j;
-                if (board->board[idx].content == ' ') {
+                if (board->content[idx] == ' ') {
                     pacman->pos_x = j;
                     pacman->pos_y = i;
-                    board->board[idx].content = 'P';
+                    board->content[idx] = 'P';
                     return 0;
                 }
             }
@@ -164,11 +187,15 @@ int read_pacman(board_t* board, int points) {
     int fd = open(board->pacman_file, O_RDONLY);
     if (fd < 0) return -1;
 
-    int read;
-    char command[MAX_COMMAND_LENGTH];
+    line_reader_t reader;
+    if (line_reader_open(&reader, fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    char* command;
 
     // Ciclo de leitura do cabeçalho de configuração
-    while ((read = read_line(fd, command)) > 0) {
+    while (line_reader_next(&reader, &command) > 0) {
         // Ignora comentários e linhas vazias
         if (command[0] == '#' || command[0] == '\0') continue;
 
@@ -189,8 +216,11 @@ int read_pacman(board_t* board, int points) {
             if (arg1 && arg2) {
                 pacman->pos_x = atoi(arg1);
                 pacman->pos_y = atoi(arg2);
-                int idx = pacman->pos_y * board->width + pacman->pos_x;
-                board->board[idx].content = 'P';
+                // Fora do tabuleiro não se escreve; load_level rejeita o nível
+                if (pacman->pos_x >= 0 && pacman->pos_x < board->width &&
+                    pacman->pos_y >= 0 && pacman->pos_y < board->height) {
+                    board->content[pacman->pos_y * board->width + pacman->pos_x] = 'P';
+                }
                 debug("Pacman posicionado em: %d, %d\n", pacman->pos_x, pacman->pos_y);
             }
         }
@@ -201,6 +231,7 @@ int read_pacman(board_t* board, int points) {
         }
     }
 
+    line_reader_close(&reader);
     close(fd);
     return 0;
 }
@@ -210,9 +241,16 @@ int read_ghosts(board_t* board) {
         int fd = open(board->ghosts_files[i], O_RDONLY);
         ghost_t* ghost = &board->ghosts[i];
 
+        line_reader_t reader;
+        if (fd < 0 || line_reader_open(&reader, fd) < 0) {
+            debug("Error opening file %s\n", board->ghosts_files[i]);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+
         int read;
-        char command[MAX_COMMAND_LENGTH];
-        while ((read = read_line(fd, command)) > 0) {
+        char* command;
+        while ((read = line_reader_next(&reader, &command)) > 0) {
             // comment
             if (command[0] == '#' || command[0] == '\0') continue;
 
@@ -233,8 +271,11 @@ int read_ghosts(board_t* board) {
                 if (arg1 && arg2) {
                     ghost->pos_x = atoi(arg1);
                     ghost->pos_y = atoi(arg2);
-                    int idx = ghost->pos_y * board->width + ghost->pos_x;
-                    board->board[idx].content = 'M';
+                    // out of bounds: nothing is written and load_level rejects the level
+                    if (ghost->pos_x >= 0 && ghost->pos_x < board->width &&
+                        ghost->pos_y >= 0 && ghost->pos_y < board->height) {
+                        board->content[ghost->pos_y * board->width + ghost->pos_x] = 'M';
+                    }
                     debug("Ghost Pos = %d x %d\n", ghost->pos_x, ghost->pos_y);
                 }
             }
@@ -249,7 +290,10 @@ int read_ghosts(board_t* board) {
         // command here still holds the previous line
         int move = 0;
         while (read > 0 && move < MAX_MOVES) {
-            if (command[0]== '#' || command[0] == '\0') continue;
+            if (command[0]== '#' || command[0] == '\0') {
+                read = line_reader_next(&reader, &command);
+                continue;
+            }
             if (command[0] == 'A' ||
                 command[0] == 'D' ||
                 command[0] == 'W' ||
@@ -269,10 +313,11 @@ int read_ghosts(board_t* board) {
                     move += 1;
                 }
             }
-            read = read_line(fd, command);
+            read = line_reader_next(&reader, &command);
         }
         ghost->n_moves = move;
 
+        line_reader_close(&reader);
         if (read == -1) {
             debug("Failed reading line\n");
             close(fd);
@@ -284,6 +329,74 @@ int read_ghosts(board_t* board) {
     return 0;
 }
 
+int line_reader_open(line_reader_t* reader, int fd) {
+    reader->fd = fd;
+    reader->capacity = LINE_READER_BUFFER_SIZE;
+    reader->buffer = malloc(reader->capacity);
+    reader->start = reader->end = 0;
+    reader->eof = 0;
+    return reader->buffer ? 0 : -1;
+}
+
+int line_reader_next(line_reader_t* reader, char** line) {
+    size_t scan = reader->start;
+
+    while (1) {
+        char* newline = memchr(reader->buffer + scan, '\n', reader->end - scan);
+        if (newline || (reader->eof && reader->end > reader->start)) {
+            // Without a newline this is the last line of the file
+            size_t line_end = newline ? (size_t)(newline - reader->buffer) : reader->end;
+            if (!newline && line_end == reader->capacity) {
+                // No room left for the terminator
+                char* bigger = realloc(reader->buffer, reader->capacity + 1);
+                if (!bigger) return -1;
+                reader->buffer = bigger;
+                reader->capacity++;
+            }
+            reader->buffer[line_end] = '\0';
+            *line = reader->buffer + reader->start;
+            reader->start = newline ? line_end + 1 : line_end;
+
+            // Strip '\r' (the old reader skipped them anywhere in the line)
+            char* dst = *line;
+            for (char* src = *line; *src; src++) {
+                if (*src != '\r') *dst++ = *src;
+            }
+            *dst = '\0';
+            return 1;
+        }
+        if (reader->eof) return 0;
+
+        // Need more data: move the partial line to the front, growing the buffer if it is full
+        size_t pending = reader->end - reader->start;
+        if (reader->start > 0) {
+            memmove(reader->buffer, reader->buffer + reader->start, pending);
+            reader->start = 0;
+            reader->end = pending;
+        }
+        if (reader->end == reader->capacity) {
+            char* bigger = realloc(reader->buffer, reader->capacity * 2);
+            if (!bigger) return -1;
+            reader->buffer = bigger;
+            reader->capacity *= 2;
+        }
+        scan = reader->end;
+
+        ssize_t n = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+        if (n < 0) {
+            if (errno == EINTR) continue; // a signal handler ran (the server installs several)
+            return -1;
+        }
+        if (n == 0) reader->eof = 1;
+        reader->end += n;
+    }
+}
+
+void line_reader_close(line_reader_t* reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
+
 int read_line(int fd, char *buf) {
     int i = 0;
     char c;
@@ -0,0 +1,56 @@
+#include <string.h>
+#include "rle.h"
+
+int rle_encode(const char* cells, int size, char* out, int out_cap) {
+    int pos = 0;
+    int i = 0;
+
+    while (i < size) {
+        int run = 1;
+        while (i + run < size && run < RLE_MAX_RUN && cells[i + run] == cells[i]) run++;
+
+        if (run >= RLE_MIN_RUN) {
+            if (pos + 2 > out_cap) return -1;
+            out[pos++] = (char)(run + 125);
+            out[pos++] = cells[i];
+            i += run;
+            continue;
+        }
+
+        // Células soltas até começar uma repetição que compense (ou encher o bloco)
+        int start = i;
+        int len = 0;
+        while (i < size && len < RLE_MAX_LITERAL) {
+            if (i + 2 < size && cells[i] == cells[i + 1] && cells[i] == cells[i + 2]) break;
+            i++;
+            len++;
+        }
+        if (pos + 1 + len > out_cap) return -1;
+        out[pos++] = (char)(len - 1);
+        memcpy(out + pos, cells + start, len);
+        pos += len;
+    }
+    return pos;
+}
+
+int rle_decode(const char* in, int in_size, char* cells, int size) {
+    int pos = 0;
+    int filled = 0;
+
+    while (pos < in_size) {
+        unsigned char c = (unsigned char)in[pos++];
+        if (c < RLE_MAX_LITERAL) {
+            int len = c + 1;
+            if (pos + len > in_size || filled + len > size) return -1;
+            memcpy(cells + filled, in + pos, len);
+            pos += len;
+            filled += len;
+        } else {
+            int run = c - 125;
+            if (pos >= in_size || filled + run > size) return -1;
+            memset(cells + filled, in[pos++], run);
+            filled += run;
+        }
+    }
+    return filled == size ? 0 : -1;
+}
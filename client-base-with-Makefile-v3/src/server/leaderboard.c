@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "leaderboard.h"
+
+// Entradas ordenadas por pontos decrescentes; position[slot] é o índice da entrada do slot (-1 se não tem)
+static leaderboard_entry_t* entries = NULL;
+static int* position = NULL;
+static int count = 0;
+static int capacity = 0;
+
+// Seqlock: ímpar enquanto um escritor está a meio de uma alteração.
+// Os escritores são serializados pelo writer_lock; os leitores nunca bloqueiam.
+static unsigned int seq = 0;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void write_begin(void) {
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(void) {
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static void swap_entries(int i, int j) {
+    leaderboard_entry_t tmp = entries[i];
+    entries[i] = entries[j];
+    entries[j] = tmp;
+    position[entries[i].slot] = i;
+    position[entries[j].slot] = j;
+}
+
+int leaderboard_init(int max_slots) {
+    entries = calloc(max_slots, sizeof(leaderboard_entry_t));
+    position = malloc(sizeof(int) * max_slots);
+    if (entries == NULL || position == NULL) return -1;
+
+    for (int i = 0; i < max_slots; i++) position[i] = -1;
+    capacity = max_slots;
+    count = 0;
+    return 0;
+}
+
+void leaderboard_update(int slot, const char* player_id, int points) {
+    if (slot < 0 || slot >= capacity) return;
+
+    pthread_mutex_lock(&writer_lock);
+    write_begin();
+
+    int i = position[slot];
+    if (i < 0) {
+        i = count++;
+        entries[i].slot = slot;
+        strncpy(entries[i].player_id, player_id, LEADERBOARD_ID_SIZE - 1);
+        entries[i].player_id[LEADERBOARD_ID_SIZE - 1] = '\0';
+        position[slot] = i;
+    }
+    entries[i].points = points;
+
+    // Os pontos mudam pouco de cada vez: a entrada sobe ou desce só umas posições
+    while (i > 0 && entries[i - 1].points < entries[i].points) {
+        swap_entries(i - 1, i);
+        i--;
+    }
+    while (i < count - 1 && entries[i + 1].points > entries[i].points) {
+        swap_entries(i, i + 1);
+        i++;
+    }
+
+    write_end();
+    pthread_mutex_unlock(&writer_lock);
+}
+
+void leaderboard_remove(int slot) {
+    if (slot < 0 || slot >= capacity) return;
+
+    pthread_mutex_lock(&writer_lock);
+    int i = position[slot];
+    if (i >= 0) {
+        write_begin();
+        for (; i < count - 1; i++) {
+            entries[i] = entries[i + 1];
+            position[entries[i].slot] = i;
+        }
+        count--;
+        position[slot] = -1;
+        write_end();
+    }
+    pthread_mutex_unlock(&writer_lock);
+}
+
+int leaderboard_top(leaderboard_entry_t* out, int k) {
+    int n = 0;
+    unsigned int before, after = 0;
+
+    do {
+        before = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue; // escritor a meio, tenta outra vez
+
+        n = __atomic_load_n(&count, __ATOMIC_RELAXED);
+        if (n > k) n = k;
+        memcpy(out, entries, sizeof(leaderboard_entry_t) * n);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+
+    return n;
+}
+
+void leaderboard_destroy(void) {
+    free(entries);
+    free(position);
+    entries = NULL;
+    position = NULL;
+    count = capacity = 0;
+}
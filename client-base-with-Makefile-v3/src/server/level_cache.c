@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <dirent.h>
+#include "level_cache.h"
+#include "parser.h"
+#include "debug.h"
+
+// Níveis já interpretados, imutáveis depois de level_cache_init
+static board_t* templates = NULL;
+static int n_templates = 0;
+static int max_cells = 0;
+
+static void* clone_array(const void* src, size_t size) {
+    if (src == NULL || size == 0) return NULL;
+    void* copy = malloc(size);
+    if (copy) memcpy(copy, src, size);
+    return copy;
+}
+
+int level_cache_init(char* dirname) {
+    struct dirent **namelist;
+    int n_levels = scandir(dirname, &namelist, filter_levels, alphasort);
+    if (n_levels < 0) return -1;
+
+    templates = calloc(n_levels > 0 ? n_levels : 1, sizeof(board_t));
+    n_templates = 0;
+
+    for (int i = 0; i < n_levels; i++) {
+        board_t* tpl = &templates[n_templates];
+        if (load_level(tpl, namelist[i]->d_name, dirname, 0) < 0) {
+            debug("Cache: nível %s ignorado (erro a carregar)\n", namelist[i]->d_name);
+            // O slot é reutilizado pelo próximo nível: liberta o que a leitura parcial alocou
+            unload_level(tpl);
+            memset(tpl, 0, sizeof(*tpl));
+        } else {
+            debug("Cache: nível %d = %s (%d x %d, %d fantasmas)\n", n_templates + 1,
+                  tpl->level_name, tpl->width, tpl->height, tpl->n_ghosts);
+            int cells = tpl->width * tpl->height;
+            if (cells > max_cells) max_cells = cells;
+            n_templates++;
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+
+    return n_templates;
+}
+
+int level_cache_count(void) {
+    return n_templates;
+}
+
+const char* level_cache_name(int index) {
+    if (index < 0 || index >= n_templates) return NULL;
+    return templates[index].level_name;
+}
+
+int level_cache_max_cells(void) {
+    return max_cells;
+}
+
+int level_cache_instantiate(int index, board_t* board, int points) {
+    if (index < 0 || index >= n_templates) return -1;
+    const board_t* tpl = &templates[index];
+    int n_cells = tpl->width * tpl->height;
+
+    char player_id[sizeof(board->player_id)];
+    memcpy(player_id, board->player_id, sizeof(player_id));
+    unsigned int rng_state = board->rng_state;
+
+    *board = *tpl;
+    memcpy(board->player_id, player_id, sizeof(player_id));
+    board->rng_state = rng_state;
+
+    board->content = clone_array(tpl->content, n_cells);
+    board->dots = clone_array(tpl->dots, BITPLANE_BYTES(n_cells));
+    board->portals = clone_array(tpl->portals, BITPLANE_BYTES(n_cells));
+    board->occupant = clone_array(tpl->occupant, n_cells * sizeof(int));
+    board->pacmans = clone_array(tpl->pacmans, tpl->n_pacmans * sizeof(pacman_t));
+    board->ghosts = clone_array(tpl->ghosts, tpl->n_ghosts * sizeof(ghost_t));
+
+    if (!board->content || !board->dots || !board->portals || !board->occupant || !board->pacmans ||
+        (tpl->n_ghosts > 0 && !board->ghosts)) {
+        unload_level(board);
+        return -1;
+    }
+
+    board->pacmans[0].points = points;
+    return 0;
+}
+
+void level_cache_destroy(void) {
+    for (int i = 0; i < n_templates; i++) {
+        unload_level(&templates[i]);
+    }
+    free(templates);
+    templates = NULL;
+    n_templates = 0;
+    max_cells = 0;
+}
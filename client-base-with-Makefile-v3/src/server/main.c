@@ -8,28 +8,41 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include "session.h"
+#include "scheduler.h"
+#include "reactor.h"
+#include "level_cache.h"
+#include "leaderboard.h"
+#include "score_store.h"
+#include "metrics.h"
 #include "protocol.h"
 #include "debug.h"
-#include "board.h" // Necessário para aceder à struct board_t para os scores
 
 // --- Estruturas e Constantes ---
 
 #define MAX_BUFFER_SIZE 10 // Tamanho do buffer de pedidos pendentes
+#define REGISTRATION_READ_SIZE 4096 // Bytes lidos de cada vez do FIFO de registo (vários pedidos)
+#define SHUTDOWN_CHECK_MS 200 // Com o buffer cheio, de quanto em quanto tempo se vê se é para sair
 
 typedef struct {
     char req_pipe_path[MAX_PIPE_PATH_LENGTH];
     char notif_pipe_path[MAX_PIPE_PATH_LENGTH];
+    session_options_t opts;
 } connection_request_t;
 
 // --- Variáveis Globais ---
 
 // Controlo do Servidor
 volatile sig_atomic_t server_shutdown = 0;
-volatile sig_atomic_t sigusr1_pending = 0;  // flag para o Top 5
+volatile sig_atomic_t sigusr1_pending = 0;  // flag para o Top K
+volatile sig_atomic_t sigusr2_pending = 0;  // flag para o snapshot de métricas
+int signal_pipe[2] = {-1, -1};              // self-pipe: os handlers acordam o poll da main
 char* global_fifo_registo = NULL;
 char* global_levels_dir = NULL;
 int global_max_games = 0;
+int global_top_k = LEADERBOARD_DEFAULT_K;
 
 // Buffer Produtor-Consumidor
 connection_request_t request_buffer[MAX_BUFFER_SIZE];
@@ -41,137 +54,351 @@ pthread_mutex_t mutex_buffer = PTHREAD_MUTEX_INITIALIZER;
 sem_t sem_empty;
 sem_t sem_full;
 
-// Gestão de Sessões Ativas (para o SIGUSR1 - Top 5)
-// Guardamos ponteiros para os boards ativos para ler os scores
-board_t** active_games; 
+// Slots de sessão ocupados; os pontos de cada jogo ativo estão na leaderboard
+int* slot_in_use;
 pthread_mutex_t mutex_sessions = PTHREAD_MUTEX_INITIALIZER;
 
+// Admissão: max_games limita quantas sessões estão ativas, não o número de threads
+sem_t sem_slots;
+
 // --- Funções Auxiliares ---
 
-// Comparador para o qsort (ordem decrescente de pontos)
-int compare_scores(const void* a, const void* b) {
-    int score_a = (*(board_t**)a)->pacmans[0].points;
-    int score_b = (*(board_t**)b)->pacmans[0].points;
-    return score_b - score_a; 
+// Os handlers só marcam uma flag e acordam a main (write é async-signal-safe); o trabalho
+// (logs, ficheiros, encerramento) é feito pela main fora do handler
+static void wake_main(void) {
+    int saved_errno = errno;
+    if (signal_pipe[1] >= 0) write(signal_pipe[1], "", 1);
+    errno = saved_errno;
 }
 
 void handle_sigusr1(int sig) {
     (void)sig;
-    sigusr1_pending = 1; // Única operação segura permitida
+    sigusr1_pending = 1;
+    wake_main();
+}
+
+void handle_sigusr2(int sig) {
+    (void)sig;
+    sigusr2_pending = 1;
+    wake_main();
 }
 
-void executar_log_top_5() {
-    pthread_mutex_lock(&mutex_sessions); // Seguro aqui, fora do handler
+// Snapshot escrito num ficheiro temporário e trocado com rename: o scraper nunca lê a meio
+void executar_snapshot_metricas() {
+    FILE* out = fopen("server_metrics.prom.tmp", "w");
+    if (!out) return;
+    metrics_write(out);
+    fclose(out);
+    rename("server_metrics.prom.tmp", "server_metrics.prom");
+    debug("Snapshot de métricas gerado.\n");
+}
+
+void executar_log_top_k() {
+    // No heap: k vem da linha de comandos e não deve decidir o tamanho da stack
+    leaderboard_entry_t* top = malloc(sizeof(leaderboard_entry_t) * global_top_k);
+    score_entry_t* records = malloc(sizeof(score_entry_t) * global_top_k);
+    if (!top || !records) {
+        log_error("executar_log_top_k: sem memória para o top %d\n", global_top_k);
+        free(top);
+        free(records);
+        return;
+    }
+
+    // Leitura sem locks: os jogos continuam a correr enquanto se escreve o log
+    int count = leaderboard_top(top, global_top_k);
 
     FILE* log = fopen("server_top_scores.log", "w");
     if (!log) {
-        pthread_mutex_unlock(&mutex_sessions);
+        free(top);
+        free(records);
         return;
     }
 
-    fprintf(log, "=== TOP 5 JOGOS ATIVOS ===\n");
-    
-    int count = 0;
-    board_t* temp_list[global_max_games];
-    
-    for (int i = 0; i < global_max_games; i++) {
-        if (active_games[i] != NULL) {
-            temp_list[count++] = active_games[i];
-        }
-    }
+    fprintf(log, "=== TOP %d JOGOS ATIVOS ===\n", global_top_k);
 
     if (count == 0) {
         fprintf(log, "Nenhum jogo ativo no momento.\n");
     } else {
-        qsort(temp_list, count, sizeof(board_t*), compare_scores);
-        int limit = (count < 5) ? count : 5;
-        for (int i = 0; i < limit; i++) {
-            fprintf(log, "Rank #%d - Jogador: %s - Pontos: %d\n", 
-            i + 1, 
-            temp_list[i]->player_id,  // Agora usamos o ID guardado
-            temp_list[i]->pacmans[0].points);
+        for (int i = 0; i < count; i++) {
+            fprintf(log, "Rank #%d - Jogador: %s - Pontos: %d\n",
+            i + 1,
+            top[i].player_id,
+            top[i].points);
+        }
+    }
+
+    // Recordes de sempre: sessões completas e depois cada nível
+    count = score_store_top(SCORE_LEVEL_TOTAL, records, global_top_k);
+    fprintf(log, "\n=== TOP %d DE SEMPRE ===\n", global_top_k);
+    for (int i = 0; i < count; i++) {
+        fprintf(log, "Rank #%d - Jogador: %s - Pontos: %d\n", i + 1, records[i].player_id, records[i].points);
+    }
+
+    for (int l = 0; l < level_cache_count(); l++) {
+        const char* level = level_cache_name(l);
+        count = score_store_top(level, records, global_top_k);
+        fprintf(log, "\n=== TOP %d DO NÍVEL %s ===\n", global_top_k, level);
+        for (int i = 0; i < count; i++) {
+            fprintf(log, "Rank #%d - Jogador: %s - Pontos: %d\n", i + 1, records[i].player_id, records[i].points);
         }
     }
 
     fclose(log);
-    pthread_mutex_unlock(&mutex_sessions);
+    free(top);
+    free(records);
     debug("Log de pontuações gerado com segurança.\n");
 }
 
+// Trata os sinais que só marcam uma flag (chamado pela main quando o poll acorda)
+static void tratar_sinais_pendentes(void) {
+    if (sigusr1_pending) {
+        executar_log_top_k();
+        sigusr1_pending = 0;
+    }
+    if (sigusr2_pending) {
+        executar_snapshot_metricas();
+        sigusr2_pending = 0;
+    }
+}
+
 void handle_server_shutdown(int sig) {
     (void)sig;
     server_shutdown = 1;
-    if (global_fifo_registo) unlink(global_fifo_registo);
-    debug("\nSinal de paragem recebido. A encerrar...\n");
-    exit(0);
+    wake_main();
 }
 
-// --- Worker Thread (Consumidor) ---
-void* worker_thread(void* arg) {
-    int thread_id = *(int*)arg;
-    free(arg);
-
-    // 1. Bloquear SIGUSR1
-    sigset_t set;
-    sigemptyset(&set);
-    sigaddset(&set, SIGUSR1);
-    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
-        debug("Erro ao bloquear SIGUSR1 na thread %d\n", thread_id);
-    }
+// Chamado pela sessão quando termina: liberta o slot para o próximo cliente
+static void release_session_slot(int slot) {
+    pthread_mutex_lock(&mutex_sessions);
+    slot_in_use[slot] = 0;
+    pthread_mutex_unlock(&mutex_sessions);
 
-    debug("Worker %d iniciado.\n", thread_id);
+    sem_post(&sem_slots);
+    debug("Slot %d libertado.\n", slot);
+}
+
+// --- Thread de Admissão (Consumidor) ---
+// Tira pedidos do buffer, espera por um slot livre e entrega a sessão ao scheduler.
+// O jogo em si corre nos workers do scheduler, por isso esta thread fica logo livre.
+void* admission_thread(void* arg) {
+    (void)arg;
+
+    debug("Thread de admissão iniciada.\n");
 
     while (!server_shutdown) {
-        // 2. Consumir pedido
+        // 1. Consumir pedido (no encerramento a main acorda esta thread sem pedido)
         sem_wait(&sem_full);
-        
+        if (server_shutdown) break;
+
         pthread_mutex_lock(&mutex_buffer);
         connection_request_t req = request_buffer[buf_out];
         buf_out = (buf_out + 1) % MAX_BUFFER_SIZE;
-        // buf_count--; // (Opcional, se não usares noutro lado)
+        buf_count--;
+        metrics_gauge_set(METRIC_REQUEST_QUEUE_DEPTH, buf_count);
         pthread_mutex_unlock(&mutex_buffer);
         
         sem_post(&sem_empty);
 
-        debug("Worker %d atendeu: %s\n", thread_id, req.req_pipe_path);
+        // 2. Esperar por um slot livre (limite de max_games)
+        while (sem_wait(&sem_slots) == -1 && errno == EINTR);
+        if (server_shutdown) break;
 
-        // 3. Limpar slot antes de começar (Segurança)
         pthread_mutex_lock(&mutex_sessions);
-        active_games[thread_id] = NULL;
+        int slot = 0;
+        while (slot_in_use[slot]) slot++;
+        slot_in_use[slot] = 1;
         pthread_mutex_unlock(&mutex_sessions);
 
-        // 4. Iniciar Sessão
-        start_session(global_levels_dir, req.req_pipe_path, req.notif_pipe_path, &active_games[thread_id]);
-
-        // 5. Limpar slot após fim (Segurança extra)
-        pthread_mutex_lock(&mutex_sessions);
-        active_games[thread_id] = NULL;
-        pthread_mutex_unlock(&mutex_sessions);
+        debug("Admissão: %s no slot %d\n", req.req_pipe_path, slot);
 
-        debug("Worker %d terminou sessão.\n", thread_id);
+        // 3. Iniciar Sessão (handshake e ticks no scheduler: esta thread nunca espera pelo cliente)
+        if (start_session(req.req_pipe_path, req.notif_pipe_path, &req.opts,
+                          slot, release_session_slot) < 0) {
+            debug("Admissão: ligação falhou para %s\n", req.req_pipe_path);
+            release_session_slot(slot);
+        }
     }
     return NULL;
 }
 
+// --- Leitura do FIFO de registo ---
+
+// Tamanho do pedido que começa em buf (o opcode e, no CONNECT_EXT, as capacidades decidem).
+// Devolve 0 se ainda não chegou o suficiente para saber e -1 se o opcode não é conhecido.
+static int registration_record_size(const char* buf, size_t avail) {
+    if (avail < 1) return 0;
+    switch (buf[0]) {
+        case OP_CODE_CONNECT: return CONNECT_REQUEST_SIZE;
+        case OP_CODE_SPECTATE: return SPECTATE_REQUEST_SIZE;
+        case OP_CODE_CONNECT_EXT:
+            if (avail < CONNECT_EXT_REQUEST_SIZE) return 0;
+            return ((unsigned char)buf[CONNECT_REQUEST_SIZE] & CLIENT_CAP_VIEWPORT) ? CONNECT_VIEWPORT_REQUEST_SIZE
+                                                                                : CONNECT_EXT_REQUEST_SIZE;
+        default: return -1;
+    }
+}
+
+static void parse_connect_request(const char* rec, connection_request_t* req) {
+    int is_ext = rec[0] == (char)OP_CODE_CONNECT_EXT;
+    memset(req, 0, sizeof(*req));
+    memcpy(req->req_pipe_path, rec + 1, MAX_PIPE_PATH_LENGTH);
+    memcpy(req->notif_pipe_path, rec + 1 + MAX_PIPE_PATH_LENGTH, MAX_PIPE_PATH_LENGTH);
+    req->req_pipe_path[MAX_PIPE_PATH_LENGTH - 1] = '\0';
+    req->notif_pipe_path[MAX_PIPE_PATH_LENGTH - 1] = '\0';
+    req->opts.extended = is_ext;
+    req->opts.caps = is_ext ? (unsigned char)rec[CONNECT_REQUEST_SIZE] : 0;
+    if (req->opts.caps & CLIENT_CAP_VIEWPORT) {
+        memcpy(&req->opts.view_width, rec + CONNECT_EXT_REQUEST_SIZE, sizeof(int));
+        memcpy(&req->opts.view_height, rec + CONNECT_EXT_REQUEST_SIZE + sizeof(int), sizeof(int));
+        if (req->opts.view_width <= 0 || req->opts.view_height <= 0) req->opts.caps &= ~CLIENT_CAP_VIEWPORT;
+    }
+}
+
+// Espectador: junta-se logo ao jogo pedido, sem passar pela admissão (não ocupa slot)
+static void handle_spectate_request(const char* rec) {
+    char notif_path[MAX_PIPE_PATH_LENGTH + 1] = {0};
+    char player_id[MAX_PIPE_PATH_LENGTH + 1] = {0};
+    memcpy(notif_path, rec + 1, MAX_PIPE_PATH_LENGTH);
+    memcpy(player_id, rec + 1 + MAX_PIPE_PATH_LENGTH, MAX_PIPE_PATH_LENGTH);
+    if (session_add_spectator(player_id, notif_path) < 0) {
+        debug("Main: espectador recusado, sem jogo ativo de '%s'\n", player_id);
+    }
+}
+
+// Espera por um lugar livre no buffer. Devolve -1 se entretanto o servidor está a encerrar.
+static int wait_buffer_slot(void) {
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SHUTDOWN_CHECK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&sem_empty, &deadline) == 0) return 0;
+        if (errno != EINTR && errno != ETIMEDOUT) return -1;
+        if (server_shutdown) return -1;
+        tratar_sinais_pendentes();
+    }
+}
+
+// Produtor: coloca os pedidos no buffer em blocos, com um só lock por bloco.
+// Se o buffer estiver cheio, espera (Backpressure natural). Pára se o servidor está a encerrar.
+static void enqueue_requests(const connection_request_t* reqs, int n) {
+    while (n > 0) {
+        int batch = n < MAX_BUFFER_SIZE ? n : MAX_BUFFER_SIZE;
+        for (int i = 0; i < batch; i++) {
+            if (wait_buffer_slot() < 0) {
+                while (i-- > 0) sem_post(&sem_empty);
+                return;
+            }
+        }
+
+        pthread_mutex_lock(&mutex_buffer);
+        for (int i = 0; i < batch; i++) {
+            request_buffer[buf_in] = reqs[i];
+            buf_in = (buf_in + 1) % MAX_BUFFER_SIZE;
+        }
+        buf_count += batch;
+        metrics_gauge_set(METRIC_REQUEST_QUEUE_DEPTH, buf_count);
+        pthread_mutex_unlock(&mutex_buffer);
+
+        for (int i = 0; i < batch; i++) sem_post(&sem_full);
+        reqs += batch;
+        n -= batch;
+    }
+}
+
+// Abre o FIFO de registo para toda a vida do servidor. O próprio servidor fica com uma
+// ponta de escrita, para que o read não devolva EOF sempre que um cliente fecha a sua.
+static int open_registration_fifo(int* fd_write) {
+    int fd = open(global_fifo_registo, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    *fd_write = open(global_fifo_registo, O_WRONLY);
+    if (*fd_write < 0) {
+        close(fd);
+        return -1;
+    }
+    // Com a ponta de escrita aberta o read pode voltar a bloquear
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
 // --- Main (Produtor / Tarefa Anfitriã) ---
 
 int main(int argc, char** argv) {
-    if (argc != 4) {
-        fprintf(stderr, "Uso: %s <levels_dir> <max_games> <fifo_registo>\n", argv[0]);
+    int opt;
+    while ((opt = getopt(argc, argv, "k:i:")) != -1) {
+        switch (opt) {
+            case 'k':
+                global_top_k = atoi(optarg);
+                break;
+            case 'i': {
+                // Política da fila de comandos: last, fifo:<max_espera> ou tick:<por_tick>
+                input_policy_t policy;
+                if (input_policy_parse(optarg, &policy) < 0) {
+                    fprintf(stderr, "Política de entrada inválida: %s (last, fifo:1-%d ou tick:1-%d)\n",
+                            optarg, INPUT_QUEUE_SIZE, MAX_TICK_MOVES);
+                    return 1;
+                }
+                session_set_input_policy(&policy);
+                break;
+            }
+            default:
+                fprintf(stderr, "Uso: %s [-k top_k] [-i last|fifo:N|tick:N] <levels_dir> <max_games> <fifo_registo>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind != 3) {
+        fprintf(stderr, "Uso: %s [-k top_k] [-i last|fifo:N|tick:N] <levels_dir> <max_games> <fifo_registo>\n", argv[0]);
         return 1;
     }
 
-    global_levels_dir = argv[1];
-    global_max_games = atoi(argv[2]);
-    global_fifo_registo = argv[3];
+    global_levels_dir = argv[optind];
+    global_max_games = atoi(argv[optind + 1]);
+    global_fifo_registo = argv[optind + 2];
 
     if (global_max_games <= 0) {
         fprintf(stderr, "max_games deve ser > 0\n");
         return 1;
     }
+    if (global_top_k <= 0 || global_top_k > LEADERBOARD_MAX_K) {
+        fprintf(stderr, "top_k deve estar entre 1 e %d\n", LEADERBOARD_MAX_K);
+        return 1;
+    }
 
     // Inicialização de Logs e Sinais
     open_debug_file("server-debug.log");
+
+    // Todas as threads criadas daqui em diante herdam a máscara: só a main recebe os sinais
+    sigset_t server_signals;
+    sigemptyset(&server_signals);
+    sigaddset(&server_signals, SIGINT);
+    sigaddset(&server_signals, SIGTERM);
+    sigaddset(&server_signals, SIGUSR1);
+    sigaddset(&server_signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &server_signals, NULL);
+
+    if (pipe(signal_pipe) < 0) {
+        perror("Erro ao criar o pipe de sinais");
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) fcntl(signal_pipe[i], F_SETFL, O_NONBLOCK);
+
+    // Todos os níveis são lidos uma só vez, aqui; as sessões trabalham sobre cópias
+    int n_levels = level_cache_init(global_levels_dir);
+    if (n_levels <= 0) {
+        if (n_levels == 0) fprintf(stderr, "Nenhum nível em: %s\n", global_levels_dir);
+        else perror("Erro scandir");
+        return 1;
+    }
+
+    // Recordes das execuções anteriores (índice mapeado, o log só é relido desde a última vez)
+    if (score_store_open(SCORE_LOG_FILE, SCORE_INDEX_FILE) < 0) {
+        perror("Falha ao abrir os recordes");
+        return 1;
+    }
     
     // Tratamento de SIGINT/SIGTERM
     struct sigaction sa_term;
@@ -188,14 +415,26 @@ int main(int argc, char** argv) {
     sa_usr.sa_flags = 0;
     sigaction(SIGUSR1, &sa_usr, NULL);
 
+    // SIGUSR2: snapshot das métricas em server_metrics.prom
+    struct sigaction sa_usr2;
+    sa_usr2.sa_handler = handle_sigusr2;
+    sigemptyset(&sa_usr2.sa_mask);
+    sa_usr2.sa_flags = 0;
+    sigaction(SIGUSR2, &sa_usr2, NULL);
+
     // Ignorar SIGPIPE (Evita crash se cliente desconectar abruptamente)
     signal(SIGPIPE, SIG_IGN);
 
     // Inicialização de Estruturas de Dados
-    active_games = calloc(global_max_games, sizeof(board_t*));
+    slot_in_use = calloc(global_max_games, sizeof(int));
+    if (leaderboard_init(global_max_games) < 0 || metrics_init(global_max_games) < 0) {
+        perror("Falha ao criar a leaderboard ou as métricas");
+        return 1;
+    }
     
     sem_init(&sem_empty, 0, MAX_BUFFER_SIZE);
     sem_init(&sem_full, 0, 0);
+    sem_init(&sem_slots, 0, global_max_games);
 
     // Criar FIFO de Registo
     unlink(global_fifo_registo);
@@ -204,81 +443,113 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    // Criar Thread Pool
-    pthread_t* workers = malloc(sizeof(pthread_t) * global_max_games);
-    for (int i = 0; i < global_max_games; i++) {
-        int* id = malloc(sizeof(int));
-        *id = i;
-        if (pthread_create(&workers[i], NULL, worker_thread, id) != 0) {
-            perror("Falha ao criar worker thread");
-            exit(1);
-        }
+    // Scheduler partilhado (um worker por core), reactor de I/O e thread de admissão
+    if (scheduler_start(0) < 0) {
+        perror("Falha ao iniciar o scheduler");
+        exit(1);
+    }
+    if (reactor_start() < 0) {
+        perror("Falha ao iniciar o reactor");
+        exit(1);
+    }
+    pthread_t admission_tid;
+    if (pthread_create(&admission_tid, NULL, admission_thread, NULL) != 0) {
+        perror("Falha ao criar thread de admissão");
+        exit(1);
     }
 
-    debug("Servidor iniciado. Pool de %d threads. Escutando: %s\n", global_max_games, global_fifo_registo);
+    debug("Servidor iniciado. Máximo de %d jogos. Escutando: %s\n", global_max_games, global_fifo_registo);
 
-    // Loop Principal (Produtor)
-    while (!server_shutdown) {
-        
-        int fd = open(global_fifo_registo, O_RDONLY);
-            
-            if (fd < 0) {
-                if (errno == EINTR) {
-                    if (sigusr1_pending) {
-                        executar_log_top_5(); // Executa a lógica pesada aqui
-                        sigusr1_pending = 0;
-                    }
-                    continue; 
-                }
-                perror("Erro ao abrir FIFO de registo");
-                break; 
-            }
+    int fd_reg_write;
+    int fd_reg = open_registration_fifo(&fd_reg_write);
+    if (fd_reg < 0) {
+        perror("Erro ao abrir FIFO de registo");
+        return 1;
+    }
 
-            char buffer[1 + 2 * MAX_PIPE_PATH_LENGTH];
-            ssize_t n = read(fd, buffer, sizeof(buffer));
-            
-            if (n < 0) {
-                if (errno == EINTR) {
-                    if (sigusr1_pending) {
-                        executar_log_top_5(); // Também verifica após o read
-                        sigusr1_pending = 0;
-                    }
-                    close(fd);
-                    continue; 
-                }
+    // Loop Principal (Produtor): cada read pode trazer vários pedidos seguidos (cada um é escrito
+    // de uma vez, abaixo de PIPE_BUF); um pedido partido entre reads fica para o seguinte
+    char buffer[REGISTRATION_READ_SIZE];
+    connection_request_t pending[REGISTRATION_READ_SIZE / CONNECT_REQUEST_SIZE];
+    size_t buffered = 0;
+
+    pthread_sigmask(SIG_UNBLOCK, &server_signals, NULL);
+
+    while (!server_shutdown) {
+        struct pollfd fds[2] = {{fd_reg, POLLIN, 0}, {signal_pipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            perror("Erro ao esperar pelo FIFO de registo");
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(signal_pipe[0], drain, sizeof(drain)) > 0);
+        }
+        tratar_sinais_pendentes();
+        if (server_shutdown || !(fds[0].revents & POLLIN)) continue;
+
+        ssize_t n = read(fd_reg, buffer + buffered, sizeof(buffer) - buffered);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro ao ler FIFO de registo");
+            break;
+        }
+        buffered += n;
+
+        int n_pending = 0;
+        size_t pos = 0;
+        while (pos < buffered) {
+            int size = registration_record_size(buffer + pos, buffered - pos);
+            if (size < 0) {
+                // Lixo no FIFO: avança byte a byte até ao próximo opcode conhecido
+                debug("Main: opcode %d desconhecido no FIFO de registo\n", buffer[pos]);
+                pos++;
+                continue;
             }
-        
-        if (n > 0 && buffer[0] == (char)OP_CODE_CONNECT) {
-            connection_request_t req;
-            strncpy(req.req_pipe_path, buffer + 1, MAX_PIPE_PATH_LENGTH);
-            strncpy(req.notif_pipe_path, buffer + 1 + MAX_PIPE_PATH_LENGTH, MAX_PIPE_PATH_LENGTH);
-            
-            debug("Main: Recebido pedido de conexão. A colocar no buffer...\n");
-
-            // Produtor: Coloca no buffer
-            // Se o buffer estiver cheio, sem_wait bloqueia (Backpressure natural)
-            if (sem_wait(&sem_empty) == -1 && errno == EINTR) {
-                // Se foi interrompido por sinal, tenta de novo ou gere conforme necessário
-                close(fd);
-                continue; 
+            if (size == 0 || buffered - pos < (size_t)size) break;
+
+            if (buffer[pos] == (char)OP_CODE_SPECTATE) {
+                // Por ordem de chegada: as ligações lidas antes vão primeiro para a admissão.
+                // Mesmo assim, um jogo só aceita espectadores depois do handshake do jogador.
+                enqueue_requests(pending, n_pending);
+                n_pending = 0;
+                handle_spectate_request(buffer + pos);
+            } else {
+                parse_connect_request(buffer + pos, &pending[n_pending++]);
             }
+            pos += size;
+        }
 
-            pthread_mutex_lock(&mutex_buffer);
-            request_buffer[buf_in] = req;
-            buf_in = (buf_in + 1) % MAX_BUFFER_SIZE;
-            buf_count++;
-            pthread_mutex_unlock(&mutex_buffer);
+        memmove(buffer, buffer + pos, buffered - pos);
+        buffered -= pos;
 
-            sem_post(&sem_full);
+        if (n_pending > 0) {
+            debug("Main: %d pedido(s) de conexão recebidos. A colocar no buffer...\n", n_pending);
+            enqueue_requests(pending, n_pending);
         }
-        
-        close(fd);
     }
 
-    // Limpeza
+    close(fd_reg);
+    close(fd_reg_write);
+
+    // Limpeza: a admissão sai primeiro; depois de parar o scheduler nenhuma sessão corre,
+    // e score_store_close ainda escreve os recordes que estavam na fila
+    debug("A encerrar o servidor...\n");
+    pthread_sigmask(SIG_BLOCK, &server_signals, NULL);
+    server_shutdown = 1;
     unlink(global_fifo_registo);
-    free(workers);
-    free(active_games);
+    sem_post(&sem_full);
+    sem_post(&sem_slots);
+    pthread_join(admission_tid, NULL);
+    scheduler_stop();
+    reactor_stop();
+    free(slot_in_use);
+    leaderboard_destroy();
+    metrics_destroy();
+    score_store_close();
+    level_cache_destroy();
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
     close_debug_file();
     return 0;
 }
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "metrics.h"
+#include "scheduler.h"
+#include "debug.h"
+
+// Baldes em potências de 2 a partir de 1 us (1 us, 2 us, ..., ~1 s) mais o +Inf
+#define HISTOGRAM_BUCKETS 21
+#define HISTOGRAM_FIRST_BOUND_NS 1000LL
+#define METRICS_MAX_WORKERS 256
+
+typedef struct {
+    const char* name;
+    const char* help;
+    unsigned long long buckets[HISTOGRAM_BUCKETS + 1]; // não cumulativos; o último é o +Inf
+    unsigned long long count;
+    unsigned long long sum_ns;
+} histogram_t;
+
+typedef struct {
+    const char* name;
+    const char* help;
+    long long value;
+} gauge_t;
+
+static histogram_t histograms[METRIC_N_HISTOGRAMS] = {
+    [METRIC_TICK_DURATION] = {"pacman_tick_duration_seconds", "Duração de um tick de sessão", {0}, 0, 0},
+    [METRIC_FRAME_ENCODE] = {"pacman_frame_encode_seconds", "Render e codificação de um tabuleiro", {0}, 0, 0},
+    [METRIC_NOTIF_WRITE] = {"pacman_notif_write_seconds", "Escrita de um tabuleiro no pipe de notificações", {0}, 0, 0},
+};
+
+static gauge_t gauges[METRIC_N_GAUGES] = {
+    [METRIC_REQUEST_QUEUE_DEPTH] = {"pacman_request_queue_depth", "Pedidos de ligação no request_buffer", 0},
+    [METRIC_ACTIVE_SESSIONS] = {"pacman_active_sessions", "Sessões registadas", 0},
+};
+
+// Totais do servidor (incluem sessões que já terminaram)
+static unsigned long long total_frames = 0;
+static unsigned long long total_bytes = 0;
+static unsigned long long total_commands = 0;
+static unsigned long long total_discarded = 0;
+
+// Sessões ativas, indexadas pelo slot
+static metrics_session_t** sessions = NULL;
+static int max_sessions = 0;
+static pthread_mutex_t sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long start_ns = 0;
+
+int metrics_init(int n_slots) {
+    sessions = calloc(n_slots, sizeof(metrics_session_t*));
+    if (sessions == NULL) return -1;
+    max_sessions = n_slots;
+    start_ns = current_time_ns();
+    return 0;
+}
+
+void metrics_observe_ns(metric_histogram_t histogram, long long ns) {
+    histogram_t* h = &histograms[histogram];
+    int bucket = 0;
+    long long bound = HISTOGRAM_FIRST_BOUND_NS;
+    while (bucket < HISTOGRAM_BUCKETS && ns > bound) {
+        bound *= 2;
+        bucket++;
+    }
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_ns, ns > 0 ? ns : 0, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_set(metric_gauge_t gauge, long long value) {
+    __atomic_store_n(&gauges[gauge].value, value, __ATOMIC_RELAXED);
+}
+
+void metrics_session_register(metrics_session_t* session) {
+    if (session->slot < 0 || session->slot >= max_sessions) return;
+    pthread_mutex_lock(&sessions_lock);
+    sessions[session->slot] = session;
+    __atomic_fetch_add(&gauges[METRIC_ACTIVE_SESSIONS].value, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&sessions_lock);
+}
+
+void metrics_session_unregister(metrics_session_t* session) {
+    if (session->slot < 0 || session->slot >= max_sessions) return;
+    pthread_mutex_lock(&sessions_lock);
+    if (sessions[session->slot] == session) {
+        sessions[session->slot] = NULL;
+        __atomic_fetch_sub(&gauges[METRIC_ACTIVE_SESSIONS].value, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&sessions_lock);
+}
+
+void metrics_count_frame(metrics_session_t* session, unsigned long long bytes) {
+    __atomic_fetch_add(&session->frames, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&session->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_frames, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void metrics_count_bytes(metrics_session_t* session, unsigned long long bytes) {
+    __atomic_fetch_add(&session->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void metrics_count_commands(metrics_session_t* session, int n) {
+    __atomic_fetch_add(&session->commands, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_commands, n, __ATOMIC_RELAXED);
+}
+
+void metrics_count_discarded(int n) {
+    __atomic_fetch_add(&total_discarded, n, __ATOMIC_RELAXED);
+}
+
+static void write_header(FILE* out, const char* name, const char* help, const char* type) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Valor de uma etiqueta no formato de texto do Prometheus: \, " e a mudança de linha são escapados
+static void write_label_value(FILE* out, const char* value) {
+    for (const char* c = value; *c; c++) {
+        if (*c == '\\') fputs("\\\\", out);
+        else if (*c == '"') fputs("\\\"", out);
+        else if (*c == '\n') fputs("\\n", out);
+        else fputc(*c, out);
+    }
+}
+
+static void write_histogram(FILE* out, histogram_t* h) {
+    write_header(out, h->name, h->help, "histogram");
+
+    unsigned long long cumulative = 0;
+    long long bound = HISTOGRAM_FIRST_BOUND_NS;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++, bound *= 2) {
+        cumulative += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        fprintf(out, "%s_bucket{le=\"%.6f\"} %llu\n", h->name, bound / 1e9, cumulative);
+    }
+    cumulative += __atomic_load_n(&h->buckets[HISTOGRAM_BUCKETS], __ATOMIC_RELAXED);
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", h->name, cumulative);
+    fprintf(out, "%s_sum %.9f\n", h->name, __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED) / 1e9);
+    fprintf(out, "%s_count %llu\n", h->name, cumulative);
+}
+
+void metrics_write(FILE* out) {
+    for (int i = 0; i < METRIC_N_HISTOGRAMS; i++) write_histogram(out, &histograms[i]);
+
+    for (int i = 0; i < METRIC_N_GAUGES; i++) {
+        write_header(out, gauges[i].name, gauges[i].help, "gauge");
+        fprintf(out, "%s %lld\n", gauges[i].name, __atomic_load_n(&gauges[i].value, __ATOMIC_RELAXED));
+    }
+
+    write_header(out, "pacman_frames_sent_total", "Tabuleiros enviados", "counter");
+    fprintf(out, "pacman_frames_sent_total %llu\n", __atomic_load_n(&total_frames, __ATOMIC_RELAXED));
+    write_header(out, "pacman_bytes_sent_total", "Bytes escritos nos pipes de notificações", "counter");
+    fprintf(out, "pacman_bytes_sent_total %llu\n", __atomic_load_n(&total_bytes, __ATOMIC_RELAXED));
+    write_header(out, "pacman_commands_received_total", "Comandos de movimento recebidos", "counter");
+    fprintf(out, "pacman_commands_received_total %llu\n", __atomic_load_n(&total_commands, __ATOMIC_RELAXED));
+    write_header(out, "pacman_commands_discarded_total", "Comandos descartados pela política de entrada", "counter");
+    fprintf(out, "pacman_commands_discarded_total %llu\n", __atomic_load_n(&total_discarded, __ATOMIC_RELAXED));
+
+    // Por sessão: a etiqueta slot distingue jogadores com o mesmo id
+    pthread_mutex_lock(&sessions_lock);
+    const char* per_session[3][2] = {
+        {"pacman_session_frames_sent_total", "Tabuleiros enviados na sessão"},
+        {"pacman_session_bytes_sent_total", "Bytes enviados na sessão (jogador e espectadores)"},
+        {"pacman_session_commands_received_total", "Comandos recebidos na sessão"},
+    };
+    for (int m = 0; m < 3; m++) {
+        write_header(out, per_session[m][0], per_session[m][1], "counter");
+        for (int i = 0; i < max_sessions; i++) {
+            metrics_session_t* s = sessions[i];
+            if (s == NULL) continue;
+            unsigned long long* field = m == 0 ? &s->frames : m == 1 ? &s->bytes : &s->commands;
+            fprintf(out, "%s{slot=\"%d\",player=\"", per_session[m][0], s->slot);
+            write_label_value(out, s->player_id);
+            fprintf(out, "\"} %llu\n", __atomic_load_n(field, __ATOMIC_RELAXED));
+        }
+    }
+    pthread_mutex_unlock(&sessions_lock);
+
+    // Utilização dos workers: fração do tempo desde o arranque passada a correr tarefas
+    sched_worker_stats_t stats[METRICS_MAX_WORKERS];
+    int n_workers = scheduler_stats(stats, METRICS_MAX_WORKERS);
+    if (n_workers > METRICS_MAX_WORKERS) n_workers = METRICS_MAX_WORKERS;
+    double uptime = (current_time_ns() - start_ns) / 1e9;
+
+    write_header(out, "pacman_worker_busy_seconds_total", "Tempo a correr tarefas por worker", "counter");
+    for (int i = 0; i < n_workers; i++) {
+        fprintf(out, "pacman_worker_busy_seconds_total{worker=\"%d\"} %.9f\n", i, stats[i].busy_ns / 1e9);
+    }
+    write_header(out, "pacman_worker_tasks_total", "Tarefas executadas por worker", "counter");
+    for (int i = 0; i < n_workers; i++) {
+        fprintf(out, "pacman_worker_tasks_total{worker=\"%d\"} %lld\n", i, stats[i].tasks_run);
+    }
+    write_header(out, "pacman_worker_utilization", "Fração do tempo ocupado desde o arranque", "gauge");
+    for (int i = 0; i < n_workers; i++) {
+        fprintf(out, "pacman_worker_utilization{worker=\"%d\"} %.6f\n", i,
+                uptime > 0 ? stats[i].busy_ns / 1e9 / uptime : 0.0);
+    }
+}
+
+void metrics_destroy(void) {
+    free(sessions);
+    sessions = NULL;
+    max_sessions = 0;
+}
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "reactor.h"
+#include "debug.h"
+
+#define REACTOR_MAX_EVENTS 64
+#define REACTOR_READ_SIZE 4096
+
+static int epoll_fd = -1;
+static int wake_fd = -1;    // eventfd para acordar o epoll_wait (remoções e paragem)
+static pthread_t reactor_tid;
+static volatile int stopping = 0;
+
+// Remoções pendentes: só são feitas pela thread do reactor, entre lotes de eventos,
+// para que nenhum evento já devolvido pelo epoll aponte para um handler libertado.
+static pthread_mutex_t removal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t removal_done = PTHREAD_COND_INITIALIZER;
+static reactor_handler_t* removals = NULL;
+
+static void wake_reactor(void) {
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+// Lê tudo o que está disponível no fd; o pipe fica vazio até ao próximo evento
+static void drain_handler(reactor_handler_t* h) {
+    char buf[REACTOR_READ_SIZE];
+
+    while (!h->closed) {
+        ssize_t n = read(h->fd, buf, sizeof(buf));
+        if (n > 0) {
+            h->on_data(h, buf, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+
+        // EOF ou erro: o cliente foi-se embora
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, h->fd, NULL);
+        h->closed = 1;
+        h->on_data(h, NULL, 0);
+    }
+}
+
+static void process_removals(void) {
+    pthread_mutex_lock(&removal_lock);
+    while (removals) {
+        reactor_handler_t* h = removals;
+        removals = h->next_removal;
+        if (!h->closed) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, h->fd, NULL);
+        h->removed = 1;
+    }
+    pthread_cond_broadcast(&removal_done);
+    pthread_mutex_unlock(&removal_lock);
+}
+
+static void* reactor_thread(void* arg) {
+    (void)arg;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    debug("Reactor iniciado.\n");
+
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) {
+            debug("Reactor: erro no epoll_wait\n");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t count;
+                ssize_t r = read(wake_fd, &count, sizeof(count));
+                (void)r;
+                continue;
+            }
+            drain_handler(events[i].data.ptr);
+        }
+
+        process_removals();
+    }
+
+    debug("Reactor a encerrar.\n");
+    return NULL;
+}
+
+int reactor_start(void) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) return -1;
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) return -1;
+
+    stopping = 0;
+    return pthread_create(&reactor_tid, NULL, reactor_thread, NULL) == 0 ? 0 : -1;
+}
+
+int reactor_add(reactor_handler_t* handler) {
+    handler->closed = 0;
+    handler->removed = 0;
+    fcntl(handler->fd, F_SETFL, fcntl(handler->fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = handler};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, handler->fd, &ev) < 0) {
+        handler->removed = 1; // nunca foi registado, reactor_remove não tem nada a fazer
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_remove(reactor_handler_t* handler) {
+    pthread_mutex_lock(&removal_lock);
+    if (handler->removed) {
+        pthread_mutex_unlock(&removal_lock);
+        return;
+    }
+    handler->next_removal = removals;
+    removals = handler;
+    wake_reactor();
+    while (!handler->removed) {
+        pthread_cond_wait(&removal_done, &removal_lock);
+    }
+    pthread_mutex_unlock(&removal_lock);
+}
+
+void reactor_stop(void) {
+    stopping = 1;
+    wake_reactor();
+    pthread_join(reactor_tid, NULL);
+    close(epoll_fd);
+    close(wake_fd);
+    epoll_fd = wake_fd = -1;
+}
@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <unistd.h>
+#include "scheduler.h"
+#include "debug.h"
+
+// Fila de tarefas prontas de um worker (ring buffer que cresce quando enche).
+// O dono e quem rouba tiram ambos do início: as tarefas saem pela ordem em que ficaram prontas,
+// para que uma rajada de tarefas novas não atrase ainda mais as que já estão atrasadas.
+typedef struct {
+    pthread_mutex_t lock;
+    sched_task_t** tasks;
+    int capacity;
+    int head;
+    int count;
+} task_deque_t;
+
+typedef struct {
+    int id;
+    pthread_t tid;
+    task_deque_t deque;
+    sched_worker_stats_t stats; // escrito pelo próprio worker, lido com atomics
+} sched_worker_t;
+
+static sched_worker_t* workers = NULL;
+static int n_workers = 0;
+static unsigned int next_worker = 0; // round robin das tarefas que vencem na roda
+
+// Um token por tarefa pronta: quem consegue um token tem garantidamente uma tarefa para tirar
+static sem_t ready_tokens;
+static volatile int stopping = 0;
+
+// Roda temporal: lista de tarefas por slot, percorrida pela thread da roda a cada WHEEL_RESOLUTION_MS
+static sched_task_t* wheel[WHEEL_SLOTS];
+static long long wheel_time = 0; // próximo instante ainda não processado
+static pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t wheel_tid;
+
+// Devolve -1 se a fila estava cheia e não foi possível aumentá-la
+static int deque_push(task_deque_t* d, sched_task_t* task) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity) {
+        int new_capacity = d->capacity ? d->capacity * 2 : 16;
+        sched_task_t** tasks = malloc(sizeof(sched_task_t*) * new_capacity);
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (int i = 0; i < d->count; i++) {
+            tasks[i] = d->tasks[(d->head + i) % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->capacity = new_capacity;
+        d->head = 0;
+    }
+    d->tasks[(d->head + d->count) % d->capacity] = task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+// Tira a tarefa pronta há mais tempo
+static sched_task_t* deque_pop(task_deque_t* d) {
+    sched_task_t* task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        task = d->tasks[d->head];
+        d->head = (d->head + 1) % d->capacity;
+        d->count--;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static void push_ready(sched_task_t* task) {
+    unsigned int w = __atomic_fetch_add(&next_worker, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < n_workers; i++) {
+        if (deque_push(&workers[(w + i) % n_workers].deque, task) == 0) {
+            sem_post(&ready_tokens);
+            return;
+        }
+    }
+
+    // Sem memória para aumentar nenhuma fila: volta à roda e tenta outra vez no próximo passo
+    log_error("Scheduler: sem memória para a fila de tarefas prontas\n");
+    pthread_mutex_lock(&wheel_lock);
+    int slot = (wheel_time / WHEEL_RESOLUTION_MS) % WHEEL_SLOTS;
+    task->next = wheel[slot];
+    wheel[slot] = task;
+    pthread_mutex_unlock(&wheel_lock);
+}
+
+void scheduler_schedule(sched_task_t* task, long long deadline_ms) {
+    task->deadline_ms = deadline_ms;
+
+    pthread_mutex_lock(&wheel_lock);
+    if (deadline_ms < wheel_time) {
+        // O instante já passou na roda: fica pronta de imediato
+        pthread_mutex_unlock(&wheel_lock);
+        push_ready(task);
+        return;
+    }
+    int slot = (deadline_ms / WHEEL_RESOLUTION_MS) % WHEEL_SLOTS;
+    task->next = wheel[slot];
+    wheel[slot] = task;
+    pthread_mutex_unlock(&wheel_lock);
+}
+
+static void* wheel_thread(void* arg) {
+    (void)arg;
+
+    while (!stopping) {
+        long long now = current_time_ms();
+        sched_task_t* due = NULL;
+
+        pthread_mutex_lock(&wheel_lock);
+        // Se a thread se atrasou mais do que uma volta, basta percorrer cada slot uma vez
+        long long steps = (now - wheel_time) / WHEEL_RESOLUTION_MS + 1;
+        if (steps > WHEEL_SLOTS) steps = WHEEL_SLOTS;
+
+        for (long long i = 0; i < steps; i++) {
+            int slot = ((wheel_time / WHEEL_RESOLUTION_MS) + i) % WHEEL_SLOTS;
+            sched_task_t** link = &wheel[slot];
+            while (*link) {
+                sched_task_t* task = *link;
+                if (task->deadline_ms <= now) {
+                    // Entregues por ordem de deadline: a mais atrasada fica à frente na fila
+                    *link = task->next;
+                    sched_task_t** pos = &due;
+                    while (*pos && (*pos)->deadline_ms <= task->deadline_ms) pos = &(*pos)->next;
+                    task->next = *pos;
+                    *pos = task;
+                } else {
+                    link = &task->next; // deadline numa das próximas voltas
+                }
+            }
+        }
+        wheel_time = now + WHEEL_RESOLUTION_MS;
+        pthread_mutex_unlock(&wheel_lock);
+
+        while (due) {
+            sched_task_t* task = due;
+            due = task->next;
+            push_ready(task);
+        }
+
+        sleep_ms(WHEEL_RESOLUTION_MS);
+    }
+    return NULL;
+}
+
+static void* scheduler_worker(void* arg) {
+    sched_worker_t* self = arg;
+
+    debug("Scheduler: worker %d iniciado.\n", self->id);
+
+    while (1) {
+        if (sem_wait(&ready_tokens) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (stopping) break;
+
+        // Primeiro a própria fila, depois roubar às outras
+        sched_task_t* task = NULL;
+        for (int i = 0; task == NULL; i = (i + 1) % n_workers) {
+            sched_worker_t* victim = &workers[(self->id + i) % n_workers];
+            task = deque_pop(&victim->deque);
+        }
+
+        long long start = current_time_ns();
+        task->run(task);
+        __atomic_fetch_add(&self->stats.busy_ns, current_time_ns() - start, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&self->stats.tasks_run, 1, __ATOMIC_RELAXED);
+    }
+
+    debug("Scheduler: worker %d a encerrar.\n", self->id);
+    return NULL;
+}
+
+int scheduler_start(int count) {
+    if (count <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cores > 0 ? (int)cores : 1;
+    }
+
+    n_workers = count;
+    workers = calloc(n_workers, sizeof(sched_worker_t));
+    if (workers == NULL) return -1;
+
+    sem_init(&ready_tokens, 0, 0);
+    stopping = 0;
+    wheel_time = current_time_ms();
+
+    for (int i = 0; i < n_workers; i++) {
+        workers[i].id = i;
+        pthread_mutex_init(&workers[i].deque.lock, NULL);
+        if (pthread_create(&workers[i].tid, NULL, scheduler_worker, &workers[i]) != 0) return -1;
+    }
+    if (pthread_create(&wheel_tid, NULL, wheel_thread, NULL) != 0) return -1;
+
+    debug("Scheduler: %d workers, roda de %d slots.\n", n_workers, WHEEL_SLOTS);
+    return 0;
+}
+
+int scheduler_stats(sched_worker_stats_t* out, int max) {
+    for (int i = 0; i < n_workers && i < max; i++) {
+        out[i].busy_ns = __atomic_load_n(&workers[i].stats.busy_ns, __ATOMIC_RELAXED);
+        out[i].tasks_run = __atomic_load_n(&workers[i].stats.tasks_run, __ATOMIC_RELAXED);
+    }
+    return n_workers;
+}
+
+void scheduler_stop(void) {
+    stopping = 1;
+    pthread_join(wheel_tid, NULL);
+
+    for (int i = 0; i < n_workers; i++) sem_post(&ready_tokens);
+    for (int i = 0; i < n_workers; i++) {
+        pthread_join(workers[i].tid, NULL);
+        pthread_mutex_destroy(&workers[i].deque.lock);
+        free(workers[i].deque.tasks);
+    }
+
+    sem_destroy(&ready_tokens);
+    free(workers);
+    workers = NULL;
+    n_workers = 0;
+}
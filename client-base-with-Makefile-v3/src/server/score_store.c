@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "score_store.h"
+#include "debug.h"
+
+#define SCORE_INDEX_MAGIC "SIDX"
+#define SCORE_INDEX_VERSION 1
+#define SCORE_INDEX_MIN_CAPACITY 1024   // entradas; cresce para o dobro acima de 70% de ocupação
+#define SCORE_QUEUE_SIZE 256
+#define SCORE_PATH_SIZE 512
+// O log é compactado quando tem mais do que este número de registos por entrada do índice
+#define SCORE_COMPACT_RATIO 4
+#define SCORE_COMPACT_MIN_BYTES (64 * 1024)
+
+// Formato do índice em disco: cabeçalho seguido de capacity entradas (tabela de hash)
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t log_offset;    // bytes do log já refletidos no índice
+} score_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    char player_id[SCORE_ID_SIZE];
+    char level[SCORE_LEVEL_SIZE];
+    int32_t points;
+    uint32_t used;
+} score_index_entry_t;
+
+// Índice mapeado; só a thread de fundo o altera, os leitores usam index_lock
+static char* index_path = NULL;
+static char* log_path = NULL;
+static score_index_header_t* index_header = NULL;
+static score_index_entry_t* index_entries = NULL;
+static size_t index_size = 0;
+static int log_fd = -1;
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Fila entre as sessões e a thread de fundo
+static score_record_t queue[SCORE_QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+static int stopping = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_tid;
+
+static uint32_t hash_key(const char* player_id, const char* level) {
+    // FNV-1a sobre os dois campos
+    uint32_t h = 2166136261u;
+    for (const char* c = player_id; *c; c++) h = (h ^ (unsigned char)*c) * 16777619u;
+    h = (h ^ 0xff) * 16777619u;
+    for (const char* c = level; *c; c++) h = (h ^ (unsigned char)*c) * 16777619u;
+    return h;
+}
+
+// Copia no máximo size - 1 caracteres e preenche o resto com zeros (o índice fica determinístico)
+static void copy_key(char* dst, const char* src, size_t size) {
+    size_t len = strnlen(src, size - 1);
+    memcpy(dst, src, len);
+    memset(dst + len, 0, size - len);
+}
+
+// Procura a entrada do par jogador/nível ou o slot livre onde deve ficar
+static score_index_entry_t* index_find(score_index_entry_t* entries, uint32_t capacity,
+                                       const char* player_id, const char* level) {
+    uint32_t i = hash_key(player_id, level) & (capacity - 1);
+    while (entries[i].used) {
+        if (strcmp(entries[i].player_id, player_id) == 0 && strcmp(entries[i].level, level) == 0) {
+            return &entries[i];
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return &entries[i];
+}
+
+static int index_map(const char* path, uint32_t capacity, int create,
+                     score_index_header_t** header_out, size_t* size_out) {
+    size_t size = sizeof(score_index_header_t) + (size_t)capacity * sizeof(score_index_entry_t);
+    int fd = open(path, O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (fd < 0) return -1;
+    if (create && ftruncate(fd, size) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    score_index_header_t* header = map;
+    if (create) {
+        memcpy(header->magic, SCORE_INDEX_MAGIC, 4);
+        header->version = SCORE_INDEX_VERSION;
+        header->capacity = capacity;
+        header->count = 0;
+        header->log_offset = 0;
+    }
+    *header_out = header;
+    *size_out = size;
+    return 0;
+}
+
+static void index_unmap(void) {
+    if (index_header) munmap(index_header, index_size);
+    index_header = NULL;
+    index_entries = NULL;
+}
+
+// Abre o índice existente se for válido; caso contrário cria um vazio (o log é relido todo)
+static int index_open(void) {
+    struct stat st;
+    int fd = open(index_path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(score_index_header_t)) {
+        score_index_header_t header;
+        ssize_t n = read(fd, &header, sizeof(header));
+        close(fd);
+        if (n == sizeof(header) && memcmp(header.magic, SCORE_INDEX_MAGIC, 4) == 0 &&
+            header.version == SCORE_INDEX_VERSION && header.capacity >= SCORE_INDEX_MIN_CAPACITY &&
+            (header.capacity & (header.capacity - 1)) == 0 &&
+            (size_t)st.st_size == sizeof(header) + (size_t)header.capacity * sizeof(score_index_entry_t) &&
+            index_map(index_path, header.capacity, 0, &index_header, &index_size) == 0) {
+            index_entries = (score_index_entry_t*)(index_header + 1);
+            return 0;
+        }
+    } else if (fd >= 0) {
+        close(fd);
+    }
+
+    debug("Recordes: índice inválido ou inexistente, a reconstruir a partir do log\n");
+    if (index_map(index_path, SCORE_INDEX_MIN_CAPACITY, 1, &index_header, &index_size) < 0) return -1;
+    index_entries = (score_index_entry_t*)(index_header + 1);
+    return 0;
+}
+
+// Duplica a tabela: novo ficheiro ao lado, preenchido e depois trocado com rename
+static int index_grow(void) {
+    char tmp_path[SCORE_PATH_SIZE];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", index_path);
+
+    score_index_header_t* header;
+    size_t size;
+    uint32_t capacity = index_header->capacity * 2;
+    if (index_map(tmp_path, capacity, 1, &header, &size) < 0) return -1;
+
+    score_index_entry_t* entries = (score_index_entry_t*)(header + 1);
+    for (uint32_t i = 0; i < index_header->capacity; i++) {
+        if (!index_entries[i].used) continue;
+        *index_find(entries, capacity, index_entries[i].player_id, index_entries[i].level) = index_entries[i];
+    }
+    header->count = index_header->count;
+    header->log_offset = index_header->log_offset;
+
+    msync(header, size, MS_SYNC);
+    if (rename(tmp_path, index_path) < 0) {
+        munmap(header, size);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    index_unmap();
+    index_header = header;
+    index_entries = entries;
+    index_size = size;
+    return 0;
+}
+
+// Guarda o máximo: aplicar o mesmo registo duas vezes não muda nada
+static void index_apply(const score_record_t* record) {
+    if ((index_header->count + 1) * 10 > index_header->capacity * 7 && index_grow() < 0) {
+        debug("Recordes: não foi possível aumentar o índice\n");
+        return;
+    }
+
+    score_index_entry_t* entry = index_find(index_entries, index_header->capacity,
+                                            record->player_id, record->level);
+    if (!entry->used) {
+        copy_key(entry->player_id, record->player_id, SCORE_ID_SIZE);
+        copy_key(entry->level, record->level, SCORE_LEVEL_SIZE);
+        entry->points = record->points;
+        entry->used = 1;
+        index_header->count++;
+    } else if (record->points > entry->points) {
+        entry->points = record->points;
+    }
+}
+
+// Aplica ao índice os registos do log que ainda não estão lá
+static int index_replay_log(void) {
+    struct stat st;
+    if (fstat(log_fd, &st) < 0) return -1;
+
+    // Log mais curto do que o índice espera: foi compactado depois da última escrita do índice
+    off_t offset = (off_t)index_header->log_offset;
+    if (offset > st.st_size) offset = 0;
+
+    size_t n_records = (st.st_size - offset) / sizeof(score_record_t);
+    if (n_records > 0) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+        if (map == MAP_FAILED) return -1;
+        const score_record_t* records = (const score_record_t*)((char*)map + offset);
+        for (size_t i = 0; i < n_records; i++) index_apply(&records[i]);
+        munmap(map, st.st_size);
+        debug("Recordes: %zu registos do log aplicados ao índice\n", n_records);
+    }
+
+    // Um registo incompleto no fim (escrita interrompida) é descartado
+    off_t end = offset + (off_t)(n_records * sizeof(score_record_t));
+    if (end != st.st_size && ftruncate(log_fd, end) < 0) return -1;
+    index_header->log_offset = end;
+    return 0;
+}
+
+// Reescreve o log só com o máximo de cada entrada do índice
+static void log_compact(void) {
+    char tmp_path[SCORE_PATH_SIZE];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", log_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+
+    score_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = time(NULL);
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < index_header->capacity; i++) {
+        if (!index_entries[i].used) continue;
+        memcpy(record.player_id, index_entries[i].player_id, SCORE_ID_SIZE);
+        memcpy(record.level, index_entries[i].level, SCORE_LEVEL_SIZE);
+        record.points = index_entries[i].points;
+        if (write(fd, &record, sizeof(record)) != sizeof(record)) {
+            close(fd);
+            unlink(tmp_path);
+            return;
+        }
+        size += sizeof(record);
+    }
+    fsync(fd);
+    close(fd);
+
+    if (rename(tmp_path, log_path) < 0) {
+        unlink(tmp_path);
+        return;
+    }
+
+    int new_fd = open(log_path, O_WRONLY | O_APPEND);
+    if (new_fd < 0) return;
+    close(log_fd);
+    log_fd = new_fd;
+    index_header->log_offset = size;
+    msync(index_header, index_size, MS_ASYNC);
+    debug("Recordes: log compactado para %u registos\n", index_header->count);
+}
+
+static void* score_writer_thread(void* arg) {
+    (void)arg;
+    score_record_t batch[SCORE_QUEUE_SIZE];
+
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_count == 0 && !stopping) pthread_cond_wait(&queue_cond, &queue_lock);
+        if (queue_count == 0 && stopping) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        int n = queue_count;
+        for (int i = 0; i < n; i++) batch[i] = queue[(queue_head + i) % SCORE_QUEUE_SIZE];
+        queue_head = (queue_head + n) % SCORE_QUEUE_SIZE;
+        queue_count = 0;
+        pthread_mutex_unlock(&queue_lock);
+
+        // Um write para o lote todo; o índice só avança sobre o que ficou no log
+        ssize_t written = write(log_fd, batch, sizeof(score_record_t) * n);
+        if (written != (ssize_t)(sizeof(score_record_t) * n)) {
+            debug("Recordes: erro a escrever no log (%s)\n", strerror(errno));
+            continue;
+        }
+
+        pthread_mutex_lock(&index_lock);
+        for (int i = 0; i < n; i++) index_apply(&batch[i]);
+        index_header->log_offset += written;
+        if (index_header->log_offset > SCORE_COMPACT_MIN_BYTES &&
+            index_header->log_offset > (uint64_t)index_header->count * SCORE_COMPACT_RATIO * sizeof(score_record_t)) {
+            log_compact();
+        }
+        pthread_mutex_unlock(&index_lock);
+
+        msync(index_header, index_size, MS_ASYNC);
+    }
+    return NULL;
+}
+
+int score_store_open(const char* log_file, const char* index_file) {
+    log_path = strdup(log_file);
+    index_path = strdup(index_file);
+
+    log_fd = open(log_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (log_fd < 0 || index_open() < 0) return -1;
+
+    long long start = current_time_ms();
+    if (index_replay_log() < 0) return -1;
+    msync(index_header, index_size, MS_ASYNC);
+    debug("Recordes: índice com %u entradas carregado em %lld ms\n",
+          index_header->count, current_time_ms() - start);
+
+    stopping = 0;
+    return pthread_create(&writer_tid, NULL, score_writer_thread, NULL) == 0 ? 0 : -1;
+}
+
+void score_store_record(const char* player_id, const char* level, int points) {
+    score_record_t record;
+    memset(&record, 0, sizeof(record));
+    copy_key(record.player_id, player_id, SCORE_ID_SIZE);
+    copy_key(record.level, level, SCORE_LEVEL_SIZE);
+    record.points = points;
+    record.timestamp = time(NULL);
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_count == SCORE_QUEUE_SIZE) {
+        pthread_mutex_unlock(&queue_lock);
+        debug("Recordes: fila cheia, pontuação de %s perdida\n", player_id);
+        return;
+    }
+    queue[(queue_head + queue_count) % SCORE_QUEUE_SIZE] = record;
+    queue_count++;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+int score_store_top(const char* level, score_entry_t* out, int k) {
+    int n = 0;
+    char key[SCORE_LEVEL_SIZE];
+    copy_key(key, level, SCORE_LEVEL_SIZE); // os nomes no índice estão truncados da mesma forma
+
+    pthread_mutex_lock(&index_lock);
+    for (uint32_t i = 0; index_entries && i < index_header->capacity; i++) {
+        score_index_entry_t* entry = &index_entries[i];
+        if (!entry->used || strcmp(entry->level, key) != 0) continue;
+
+        // Inserção ordenada nas k melhores
+        int pos = n < k ? n++ : k;
+        while (pos > 0 && out[pos - 1].points < entry->points) {
+            if (pos < k) out[pos] = out[pos - 1];
+            pos--;
+        }
+        if (pos < k) {
+            memcpy(out[pos].player_id, entry->player_id, SCORE_ID_SIZE);
+            memcpy(out[pos].level, entry->level, SCORE_LEVEL_SIZE);
+            out[pos].points = entry->points;
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+    return n;
+}
+
+void score_store_close(void) {
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    pthread_join(writer_tid, NULL);
+
+    msync(index_header, index_size, MS_SYNC);
+    index_unmap();
+    close(log_fd);
+    log_fd = -1;
+    free(log_path);
+    free(index_path);
+    log_path = index_path = NULL;
+}
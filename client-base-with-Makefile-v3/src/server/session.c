@@ -1,255 +1,886 @@
+#define _GNU_SOURCE // F_GETPIPE_SZ / F_SETPIPE_SZ
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <pthread.h>
 #include "board.h"
 #include "protocol.h"
 #include "display.h"
 #include "debug.h"
-#include "parser.h"
-
-// Estrutura para sincronizar a paragem das threads da sessão
+#include "level_cache.h"
+#include "session.h"
+#include "scheduler.h"
+#include "reactor.h"
+#include "leaderboard.h"
+#include "score_store.h"
+#include "metrics.h"
+#include "frame_shm.h"
+#include "rle.h"
+
+// Handshake: o cliente tem este tempo para abrir o seu lado do pipe de notificações
+#define HANDSHAKE_TIMEOUT_MS 5000
+#define HANDSHAKE_RETRY_MS 10
+// Cliente que não aceita bytes no pipe de notificações durante este tempo é desligado
+#define NOTIF_STALL_TIMEOUT_MS 5000
+
+// Fila de comandos da sessão: um só produtor (a thread do reactor) e um só consumidor
+// (o worker que corre o tick), sem locks. Os índices só crescem; a posição é índice % tamanho.
 typedef struct {
-    int fd_req;
-    board_t* board;
-    volatile int* session_running;
-    volatile int* level_finished;
-} pacman_task_args;
+    char moves[INPUT_QUEUE_SIZE];
+    unsigned int head;      // escrito só pelo reactor
+    unsigned int tail;      // escrito só pelo tick
+} input_queue_t;
 
+// Bytes do pipe de pedidos ainda por completar; só a thread do reactor lhe toca
 typedef struct {
-    board_t* board;
-    int ghost_index;
-    volatile int* session_running;
-    volatile int* level_finished;
-} ghost_task_args;
-
-void* server_pacman_task(void* arg) {
-    pacman_task_args* a = (pacman_task_args*)arg;
-    char op_code;
-    char move_dir;
-
-    debug("Thread de escuta de comandos iniciada.\n");
-
-    while (*a->session_running&& !(*a->level_finished)) {
-        // 1. Ler apenas 1 byte para saber qual é a operação
-        ssize_t n = read(a->fd_req, &op_code, 1);
-        
-        if (n <= 0) { 
-            debug("Cliente desconectado (Pipe fechado).\n");
-            *a->session_running = 0;
+    char pending[2];        // comando ainda incompleto (ex.: OP_CODE_PLAY sem direção)
+    int n_pending;
+} request_parser_t;
+
+static input_policy_t input_policy = {INPUT_POLICY_PER_TICK, MAX_TICK_MOVES};
+
+int input_policy_parse(const char* spec, input_policy_t* policy) {
+    if (strcmp(spec, "last") == 0) {
+        policy->mode = INPUT_POLICY_LAST_WINS;
+        policy->limit = 1;
+        return 0;
+    }
+
+    const char* colon = strchr(spec, ':');
+    if (colon == NULL) return -1;
+    size_t name_len = colon - spec;
+    char* end;
+    long limit = strtol(colon + 1, &end, 10);
+    if (*end != '\0' || limit <= 0) return -1;
+
+    if (name_len == 4 && strncmp(spec, "fifo", 4) == 0 && limit <= INPUT_QUEUE_SIZE) {
+        policy->mode = INPUT_POLICY_FIFO;
+    } else if (name_len == 4 && strncmp(spec, "tick", 4) == 0 && limit <= MAX_TICK_MOVES) {
+        policy->mode = INPUT_POLICY_PER_TICK;
+    } else {
+        return -1;
+    }
+    policy->limit = (int)limit;
+    return 0;
+}
+
+void session_set_input_policy(const input_policy_t* policy) {
+    input_policy = *policy;
+}
+
+// Produtor. Com a fila cheia o comando novo perde-se; devolve 0 nesse caso.
+static int input_queue_push(input_queue_t* q, char move) {
+    unsigned int capacity = input_policy.mode == INPUT_POLICY_FIFO ? (unsigned int)input_policy.limit : INPUT_QUEUE_SIZE;
+    unsigned int head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= capacity) return 0;
+    q->moves[head % INPUT_QUEUE_SIZE] = move;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Consumidor, no início do tick: tira da fila os comandos deste tick segundo a política.
+// Devolve quantos comandos foram descartados.
+static int input_queue_drain(input_queue_t* q, board_inputs_t* inputs) {
+    unsigned int head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = q->tail;
+    unsigned int available = head - tail;
+    inputs->n_moves = 0;
+    if (available == 0) return 0;
+
+    int discarded = 0;
+    switch (input_policy.mode) {
+        case INPUT_POLICY_LAST_WINS:
+            inputs->moves[inputs->n_moves++] = q->moves[(head - 1) % INPUT_QUEUE_SIZE];
+            discarded = available - 1;
+            tail = head;
             break;
+        case INPUT_POLICY_FIFO:
+            inputs->moves[inputs->n_moves++] = q->moves[tail % INPUT_QUEUE_SIZE];
+            tail++; // os restantes ficam para os próximos ticks
+            break;
+        case INPUT_POLICY_PER_TICK:
+            while (tail != head && inputs->n_moves < input_policy.limit) {
+                inputs->moves[inputs->n_moves++] = q->moves[tail % INPUT_QUEUE_SIZE];
+                tail++;
+            }
+            discarded = head - tail;
+            tail = head;
+            break;
+    }
+    __atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+    return discarded;
+}
+
+// Buffers de codificação da sessão, reutilizados entre tabuleiros e níveis
+// (só crescem quando um nível maior é carregado)
+typedef struct {
+    int board_size;         // células da janela
+    int capacity;
+    char* frame;            // tabuleiro atual, desenhado por render_board
+    char* last_frame;       // último tabuleiro enviado, NULL se o cliente não suporta deltas
+    char* delta_buf;
+    char* rle_buf;          // tabuleiros completos comprimidos, NULL sem CLIENT_CAP_RLE
+    int frames_since_keyframe;
+    // Janela enviada ao cliente: o tabuleiro inteiro sem CLIENT_CAP_VIEWPORT
+    int view_x, view_y;
+    int view_width, view_height;
+} frame_encoder_t;
+
+// Origem da janela num eixo: só volta a centrar no pacman quando ele chega a menos de um quarto
+// da janela de uma das bordas, para que a janela não mude (nem estrague os deltas) a cada passo
+static int viewport_axis(int origin, int view, int size, int pos, int recentre) {
+    int margin = view / 4;
+    if (recentre || pos < origin + margin || pos >= origin + view - margin) origin = pos - view / 2;
+    if (origin > size - view) origin = size - view;
+    if (origin < 0) origin = 0;
+    return origin;
+}
+
+static void viewport_follow(frame_encoder_t* enc, board_t* board, int recentre) {
+    enc->view_x = viewport_axis(enc->view_x, enc->view_width, board->width, board->pacmans[0].pos_x, recentre);
+    enc->view_y = viewport_axis(enc->view_y, enc->view_height, board->height, board->pacmans[0].pos_y, recentre);
+}
+
+// Pipe de notificações em modo não bloqueante: o worker nunca espera por um cliente.
+// O que o pipe não aceitou de uma mensagem já começada fica aqui e sai nos ticks seguintes;
+// nunca há mais do que uma mensagem pendente.
+typedef struct {
+    char* buf;                  // cabeçalho + maior tabuleiro
+    size_t off;
+    size_t len;                 // bytes pendentes a partir de off
+    long long stalled_since;    // ms desde que o cliente deixou de ler, 0 se está a ler
+} notif_backlog_t;
+
+static int backlog_flush(int fd, notif_backlog_t* b) {
+    while (b->len > 0) {
+        ssize_t n = write(fd, b->buf + b->off, b->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
         }
+        b->off += n;
+        b->len -= n;
+    }
+    return 0;
+}
 
-        // 2. Tratar cada tipo de operação
+// Escreve a mensagem se o pipe a aceitar; o resto de uma escrita parcial vai para o backlog.
+// Devolve 1 se a mensagem foi aceite, 0 se foi descartada (pipe cheio ou a anterior ainda
+// pendente) e -1 se o cliente fechou o pipe.
+static int notif_send(int fd, notif_backlog_t* b, const struct iovec* iov, int iovcnt) {
+    if (backlog_flush(fd, b) < 0) return -1;
+    if (b->len > 0) return 0;
+
+    ssize_t n;
+    do {
+        n = writev(fd, iov, iovcnt);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return errno == EAGAIN ? 0 : -1;
+
+    // Mensagem começada: o resto tem de seguir, senão o cliente perde o alinhamento
+    b->off = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t skip = (size_t)n < iov[i].iov_len ? (size_t)n : iov[i].iov_len;
+        n -= skip;
+        memcpy(b->buf + b->len, (const char*)iov[i].iov_base + skip, iov[i].iov_len - skip);
+        b->len += iov[i].iov_len - skip;
+    }
+    return 1;
+}
+
+// Codifica em out as células de cur que mudaram face a prev, no formato de OP_CODE_BOARD_DELTA.
+// Devolve o tamanho do payload, ou -1 se não couber em out_cap (nesse caso compensa enviar tudo).
+static int encode_board_delta(const char* prev, const char* cur, int size, char* out, int out_cap) {
+    int n_runs = 0;
+    int pos = sizeof(int); // reservado para n_runs
+
+    int i = 0;
+    while (i < size) {
+        if (prev[i] == cur[i]) { i++; continue; }
+
+        // Junta diferenças próximas: um intervalo curto igual custa menos do que um novo cabeçalho
+        int start = i;
+        int end = i + 1;
+        for (int j = end; j < size && j - end < (int)(2 * sizeof(int)); j++) {
+            if (prev[j] != cur[j]) end = j + 1;
+        }
+
+        int len = end - start;
+        if (pos + 2 * (int)sizeof(int) + len > out_cap) return -1;
+        memcpy(out + pos, &start, sizeof(int));
+        memcpy(out + pos + sizeof(int), &len, sizeof(int));
+        memcpy(out + pos + 2 * sizeof(int), cur + start, len);
+        pos += 2 * sizeof(int) + len;
+        n_runs++;
+        i = end;
+    }
+
+    memcpy(out, &n_runs, sizeof(int));
+    return pos;
+}
+
+// Passa para a fila os comandos completos recebidos do cliente.
+// Devolve -1 se o cliente pediu para desligar; senão, quantos comandos de movimento leu.
+static int parse_requests(request_parser_t* parser, input_queue_t* queue, const char* buf, ssize_t n,
+                          int* discarded) {
+    int n_commands = 0;
+    for (ssize_t i = 0; i < n; i++) {
+        parser->pending[parser->n_pending++] = buf[i];
+
+        char op_code = parser->pending[0];
         if (op_code == (char)OP_CODE_PLAY) {
-            // Se é um movimento, agora lemos o segundo byte (a direção)
-            if (read(a->fd_req, &move_dir, 1) > 0) {
-                
-                debug("Servidor: Recebido comando de movimento '%c'\n", move_dir);
-
-                command_t cmd = {move_dir, 1, 1};
-                
-                pthread_rwlock_wrlock(&a->board->state_lock);
-                
-
-                // 1. Guardar posição antes
-                int x_antes = a->board->pacmans[0].pos_x;
-                int y_antes = a->board->pacmans[0].pos_y;
-
-                a->board->pacmans[0].alive = 1; 
-                a->board->pacmans[0].passo = 0;   // Remove o cooldown para o teclado responder logo
-                a->board->pacmans[0].waiting = 0; // Garante que não está em espera
-                                
-                int res=move_pacman(a->board, 0, &cmd);
-
-                // 3. Guardar posição depois
-                int x_depois = a->board->pacmans[0].pos_x;
-                int y_depois = a->board->pacmans[0].pos_y;
-
-                // 4. Imprimir o resultado no log
-                debug("LOG MOVIMENTO: Tecla %c | Posição: (%d,%d) -> (%d,%d)\n", 
-                    move_dir, x_antes, y_antes, x_depois, y_depois);
-
-                pthread_rwlock_unlock(&a->board->state_lock);
-                if (res==REACHED_PORTAL){
-                    debug("Portal atingido! A mudar de nível...\n");
-                    *a->level_finished = 1;
-                }
-            }
-        } 
-        else if (op_code == (char)OP_CODE_DISCONNECT) {
+            if (parser->n_pending < 2) continue; // falta a direção
+            char move_dir = parser->pending[1];
+            debug("Servidor: Recebido comando de movimento '%c'\n", move_dir);
+            n_commands++;
+            if (!input_queue_push(queue, move_dir)) (*discarded)++;
+        } else if (op_code == (char)OP_CODE_DISCONNECT) {
             debug("Servidor: Cliente enviou pedido de desconexão voluntária.\n");
-            *a->session_running = 0;
-            break;
+            return -1;
         }
+        parser->n_pending = 0;
     }
-    
-    debug("Encerrando thread de escuta de comandos.\n");
-    return NULL;
-}
-
-void* server_ghost_task(void* arg) {
-    ghost_task_args* a = (ghost_task_args*)arg;
-    ghost_t* ghost = &a->board->ghosts[a->ghost_index];
-
-    debug("Thread do Fantasma %d iniciada.\n", a->ghost_index);
-
-    while (*a->session_running && !(*a->level_finished)) {
-        // 1. Verificar se o fantasma tem movimentos ou é aleatório
-        command_t* cmd = NULL;
-        
-        // Se houver movimentos pré-definidos no ficheiro .m
-        if (ghost->n_moves > 0) {
-            cmd = &ghost->moves[ghost->current_move % ghost->n_moves];
-        } else {
-            // Se não houver, cria um comando aleatório (R = Random)
-            static command_t random_cmd = {'R', 0, 0}; 
-            cmd = &random_cmd;
+    return n_commands;
+}
+
+// Envia o estado atual do tabuleiro (delta se compensar; os completos comprimidos se o cliente
+// aceitar e ficarem mais pequenos). Se o pipe está cheio o tabuleiro é descartado e o próximo
+// vai completo. Devolve -1 se o cliente fechou o pipe ou não lê há NOTIF_STALL_TIMEOUT_MS.
+// victory marca o último tabuleiro de um jogo ganho.
+// sent/payload ficam com a mensagem codificada (cabeçalho completo), válida até ao próximo tabuleiro.
+static int send_board_frame(int fd_notif, notif_backlog_t* backlog, board_t* board, int victory,
+                            const session_options_t* opts, frame_encoder_t* enc,
+                            metrics_session_t* stats, frame_header_t* sent, const char** payload) {
+    long long encode_start = current_time_ns();
+    char* board_str = enc->frame;
+    render_board_window(board, enc->view_x, enc->view_y, enc->view_width, enc->view_height, board_str);
+
+    // Primeiro tabuleiro do nível e keyframes periódicos vão completos
+    int delta_len = -1;
+    if (enc->last_frame && enc->frames_since_keyframe > 0 && enc->frames_since_keyframe < DELTA_KEYFRAME_INTERVAL) {
+        delta_len = encode_board_delta(enc->last_frame, board_str, enc->board_size, enc->delta_buf, enc->board_size);
+    }
+
+    char op_code = (char)OP_CODE_BOARD;
+    const char* payload_buf = board_str;
+    int payload_size = enc->board_size;
+    if (delta_len >= 0) {
+        op_code = (char)OP_CODE_BOARD_DELTA;
+        payload_buf = enc->delta_buf;
+        payload_size = delta_len;
+    } else if (enc->rle_buf) {
+        int rle_len = rle_encode(board_str, enc->board_size, enc->rle_buf, enc->board_size - 1);
+        if (rle_len >= 0) {
+            op_code = (char)OP_CODE_BOARD_RLE;
+            payload_buf = enc->rle_buf;
+            payload_size = rle_len;
         }
+    }
 
-        // 2. Bloquear o estado global para garantir consistência (igual ao Pacman)
-        pthread_rwlock_wrlock(&a->board->state_lock);
-        
-        // Executa o movimento (a lógica de colisão está dentro desta função)
-        move_ghost(a->board, a->ghost_index, cmd);
-        
-        pthread_rwlock_unlock(&a->board->state_lock);
+    frame_header_t header = {
+        .op_code = op_code,
+        .width = enc->view_width,
+        .height = enc->view_height,
+        .tempo = board->tempo,
+        .victory = victory,
+        .game_over = !board->pacmans[0].alive,
+        .points = board->pacmans[0].points,
+        .payload_size = payload_size,
+        .view_x = enc->view_x,
+        .view_y = enc->view_y,
+    };
+
+    // Cabeçalho e tabuleiro num único writev
+    struct iovec iov[2] = {
+        {&header, opts->extended ? sizeof(header) : FRAME_HEADER_LEGACY_SIZE},
+        {(void*)payload_buf, header.payload_size},
+    };
+    size_t frame_bytes = iov[0].iov_len + iov[1].iov_len;
+
+    long long write_start = current_time_ns();
+    metrics_observe_ns(METRIC_FRAME_ENCODE, write_start - encode_start);
+    int accepted = notif_send(fd_notif, backlog, iov, 2);
+    metrics_observe_ns(METRIC_NOTIF_WRITE, current_time_ns() - write_start);
+    if (accepted < 0) return -1;
+    if (accepted) metrics_count_frame(stats, frame_bytes);
+
+    *sent = header;
+    *payload = iov[1].iov_base;
+
+    if (delta_len >= 0) enc->frames_since_keyframe++;
+    else enc->frames_since_keyframe = 1;
+    if (!accepted) enc->frames_since_keyframe = 0; // o cliente não tem a base do próximo delta
+
+    if (enc->last_frame) {
+        // O tabuleiro atual passa a ser a base do próximo delta
+        enc->frame = enc->last_frame;
+        enc->last_frame = board_str;
+    }
 
-        // 3. Respeitar o tempo do jogo
-        sleep_ms(a->board->tempo);
+    if (accepted && backlog->len == 0) {
+        backlog->stalled_since = 0;
+    } else if (backlog->stalled_since == 0) {
+        backlog->stalled_since = current_time_ms();
+    } else if (current_time_ms() - backlog->stalled_since > NOTIF_STALL_TIMEOUT_MS) {
+        debug("Cliente não lê o pipe de notificações há %d ms\n", NOTIF_STALL_TIMEOUT_MS);
+        return -1;
     }
-    
-    debug("Thread do Fantasma %d a encerrar.\n", a->ghost_index);
-    free(a);
-    return NULL;
+    return 0;
 }
 
-void start_session(char* levels_dir, char* req_path, char* notif_path, board_t** active_game_slot) {
+// Transporte por memória partilhada: o tabuleiro é desenhado diretamente no segmento, sem deltas
+static void publish_board_shm(frame_shm_t* shm, board_t* board, int victory, const frame_encoder_t* enc,
+                              metrics_session_t* stats, frame_header_t* sent, const char** payload) {
+    long long encode_start = current_time_ns();
+    int slot = frame_shm_write_begin(shm);
+    char* cells = frame_shm_cells(shm, slot);
+    render_board_window(board, enc->view_x, enc->view_y, enc->view_width, enc->view_height, cells);
+    shm->slots[slot].header = (frame_header_t){
+        .op_code = (char)OP_CODE_BOARD,
+        .width = enc->view_width,
+        .height = enc->view_height,
+        .tempo = board->tempo,
+        .victory = victory,
+        .game_over = !board->pacmans[0].alive,
+        .points = board->pacmans[0].points,
+        .payload_size = enc->board_size,
+        .view_x = enc->view_x,
+        .view_y = enc->view_y,
+    };
+
+    long long write_start = current_time_ns();
+    frame_shm_write_end(shm, slot);
+    metrics_observe_ns(METRIC_FRAME_ENCODE, write_start - encode_start);
+    metrics_observe_ns(METRIC_NOTIF_WRITE, current_time_ns() - write_start);
+    metrics_count_frame(stats, sizeof(frame_header_t) + enc->board_size);
+
+    // Só este worker escreve no segmento: até ao próximo tick as células não mudam
+    *sent = shm->slots[slot].header;
+    *payload = cells;
+}
+
+// Espectador de uma sessão: pipe de notificações em modo não bloqueante
+typedef struct {
+    int fd;
+    int pipe_size;          // capacidade do pipe, para nunca fazer escritas parciais
+    int waiting_keyframe;   // perdeu (ou ainda não recebeu) um tabuleiro: os deltas não lhe servem
+} spectator_t;
+
+struct session {
+    sched_task_t task;          // primeiro campo: o scheduler só conhece a task
+    reactor_handler_t reader;   // pipe de pedidos, lido pela thread do reactor
     board_t board;
-    struct dirent **namelist;
-    volatile int session_running = 1;
-    int score_acumulado = 0;
-    memset(board.player_id, 0, sizeof(board.player_id));
-    
-    // Encontra a última barra '/' para ignorar a diretoria /tmp/
-    char *nome_base = strrchr(req_path, '/');
-    if (nome_base) {
-        nome_base++; // Avança a barra
-    } else {
-        nome_base = req_path;
+    int n_levels;
+    int current_level;
+    int level_loaded;
+    int level_started;          // já foi enviado o primeiro tabuleiro do nível
+    int score_acumulado;        // pontos com que o nível atual começou
+    int fd_req;
+    int fd_notif;               // não bloqueante; o que não coube fica em notif_backlog
+    notif_backlog_t notif_backlog;
+    session_options_t opts;
+    // Fila de entrada: escrita pelo reactor, esvaziada no início de cada tick
+    request_parser_t parser;
+    input_queue_t inputs;
+    int client_gone;            // desconexão pedida ou pipe fechado (atómico)
+    frame_encoder_t encoder;
+    frame_shm_t* shm;           // NULL: tabuleiros pelo pipe de notificações
+    char shm_name[FRAME_SHM_NAME_LENGTH];
+    metrics_session_t stats;
+    // Espectadores: o main junta-os (sob spectators_lock), o tick escreve-lhes e retira-os
+    pthread_mutex_t spectators_lock;
+    spectator_t spectators[MAX_SPECTATORS];
+    int n_spectators;
+    int spectator_joined;       // o próximo tabuleiro vai completo, para o novo espectador começar já
+    struct session* next_active;
+    long long next_tick;
+    int slot;
+    int published_points;       // últimos pontos enviados para a leaderboard
+    void (*on_end)(int slot);
+    // Até o cliente abrir o pipe de notificações a task corre session_handshake
+    char notif_path[MAX_PIPE_PATH_LENGTH];
+    long long handshake_deadline;
+};
+
+// Sessões ativas, para encontrar o jogo pedido por um espectador
+static session_t* active_sessions = NULL;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void registry_add(session_t* s) {
+    pthread_mutex_lock(&registry_lock);
+    s->next_active = active_sessions;
+    active_sessions = s;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static void registry_remove(session_t* s) {
+    pthread_mutex_lock(&registry_lock);
+    for (session_t** p = &active_sessions; *p; p = &(*p)->next_active) {
+        if (*p == s) {
+            *p = s->next_active;
+            break;
+        }
     }
+    pthread_mutex_unlock(&registry_lock);
+}
 
-    // Copia até encontrar o underscore '_' de "_request"
-    char *underscore = strstr(nome_base, "_request");
-    if (underscore) {
-        size_t len = underscore - nome_base;
-        if (len >= sizeof(board.player_id)) len = sizeof(board.player_id) - 1;
-        strncpy(board.player_id, nome_base, len);
-        board.player_id[len] = '\0';
-    } else {
-        strcpy(board.player_id, "Unknown");
+int session_add_spectator(const char* player_id, const char* notif_path) {
+    // O cliente abriu o pipe para leitura antes do pedido: abrir para escrita não bloqueia
+    int fd = open(notif_path, O_WRONLY | O_NONBLOCK);
+    if (fd < 0) return -1;
+
+    // Cabem pelo menos dois tabuleiros completos do maior nível (senão nunca recebia nenhum)
+    int needed = 2 * (int)(sizeof(frame_header_t) + level_cache_max_cells());
+    int pipe_size = fcntl(fd, F_GETPIPE_SZ);
+    if (pipe_size > 0 && pipe_size < needed) {
+        int grown = fcntl(fd, F_SETPIPE_SZ, needed);
+        if (grown > 0) pipe_size = grown;
+    }
+
+    char response[2] = {(char)OP_CODE_SPECTATE, 1};
+    int added = 0;
+    pthread_mutex_lock(&registry_lock);
+    session_t* s = active_sessions;
+    while (s && strcmp(s->stats.player_id, player_id) != 0) s = s->next_active;
+    if (s && pipe_size > 0) {
+        pthread_mutex_lock(&s->spectators_lock);
+        if (s->n_spectators < MAX_SPECTATORS) {
+            // A resposta sai antes de qualquer tabuleiro: o tick só vê o espectador depois disto
+            response[1] = 0;
+            write(fd, response, sizeof(response));
+            s->spectators[s->n_spectators++] = (spectator_t){fd, pipe_size, 1};
+            s->spectator_joined = 1;
+            added = 1;
+        }
+        pthread_mutex_unlock(&s->spectators_lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (!added) {
+        write(fd, response, sizeof(response));
+        close(fd);
+        return -1;
+    }
+    debug("Espectador %s a assistir ao jogo de %s\n", notif_path, player_id);
+    return 0;
+}
+
+// Os mesmos bytes para todos os espectadores, codificados uma vez. Nunca bloqueia: um espectador
+// sem espaço no pipe perde o tabuleiro e espera pelo próximo keyframe.
+// Os primeiros n espectadores só são alterados por este worker.
+static void fan_out_frame(session_t* s, int n, const frame_header_t* header, const char* payload) {
+    size_t frame_bytes = sizeof(frame_header_t) + header->payload_size;
+    unsigned long long sent_bytes = 0;
+    int removed = 0;
+
+    for (int i = 0; i < n; i++) {
+        spectator_t* sp = &s->spectators[i];
+        if (header->op_code == (char)OP_CODE_BOARD || header->op_code == (char)OP_CODE_BOARD_RLE) {
+            sp->waiting_keyframe = 0;
+        }
+        if (sp->waiting_keyframe) continue;
+
+        int queued = 0;
+        if (ioctl(sp->fd, FIONREAD, &queued) < 0 || (size_t)(sp->pipe_size - queued) < frame_bytes) {
+            sp->waiting_keyframe = 1;
+            continue;
+        }
+
+        struct iovec iov[2] = {
+            {(void*)header, sizeof(frame_header_t)},
+            {(void*)payload, header->payload_size},
+        };
+        // Com espaço garantido a escrita é completa; o resto é o espectador que fechou o pipe
+        if (writev(sp->fd, iov, 2) != (ssize_t)frame_bytes) {
+            close(sp->fd);
+            sp->fd = -1;
+            removed = 1;
+            continue;
+        }
+        sent_bytes += frame_bytes;
     }
-    // -----------------------------------------------
+    if (sent_bytes > 0) metrics_count_bytes(&s->stats, sent_bytes);
 
-    // --- LIGAÇÃO AO SIGUSR1 ---
-    if (active_game_slot != NULL) {
-        *active_game_slot = &board;
+    if (removed) {
+        pthread_mutex_lock(&s->spectators_lock);
+        int kept = 0;
+        for (int i = 0; i < s->n_spectators; i++) {
+            if (s->spectators[i].fd >= 0) s->spectators[kept++] = s->spectators[i];
+        }
+        s->n_spectators = kept;
+        pthread_mutex_unlock(&s->spectators_lock);
+    }
+}
+
+static int session_load_level(session_t* s) {
+    // Cópia do nível já interpretado, sem tocar no disco
+    if (level_cache_instantiate(s->current_level, &s->board, s->score_acumulado) < 0) {
+        return -1;
+    }
+    debug("Nível %d: %s\n", s->current_level + 1, s->board.level_name);
+    s->level_loaded = 1;
+    s->level_started = 0;
+
+    // Janela do nível: a pedida pelo cliente, sem passar do tabuleiro, centrada no pacman.
+    // Os buffers já têm o tamanho do maior nível da cache.
+    frame_encoder_t* enc = &s->encoder;
+    enc->view_width = s->board.width;
+    enc->view_height = s->board.height;
+    if (s->opts.caps & CLIENT_CAP_VIEWPORT) {
+        if (s->opts.view_width < enc->view_width) enc->view_width = s->opts.view_width;
+        if (s->opts.view_height < enc->view_height) enc->view_height = s->opts.view_height;
     }
-    // --------------------------
+    viewport_follow(enc, &s->board, 1);
+    enc->board_size = enc->view_width * enc->view_height;
+    enc->frames_since_keyframe = 0;
+    return 0;
+}
 
-    // 1. Procurar ficheiros .lvl
-    int n_levels = scandir(levels_dir, &namelist, filter_levels, alphasort);
-    if (n_levels <= 0) {
-        // Se falhar, limpamos o slot para evitar leituras de lixo
-        if (active_game_slot) *active_game_slot = NULL;
-        if (n_levels == 0) fprintf(stderr, "Nenhum nível em: %s\n", levels_dir);
-        else perror("Erro scandir");
+// Só escreve na leaderboard quando os pontos mudam
+static void session_publish_score(session_t* s) {
+    int points = s->board.pacmans[0].points;
+    if (points == s->published_points) return;
+    leaderboard_update(s->slot, s->board.player_id, points);
+    s->published_points = points;
+}
+
+// Recorde do nível que está a terminar: só os pontos ganhos nele
+static void session_record_level(session_t* s) {
+    if (!s->level_loaded) return;
+    score_store_record(s->board.player_id, s->board.level_name,
+                       s->board.pacmans[0].points - s->score_acumulado);
+}
+
+static void session_unload_level(session_t* s) {
+    if (!s->level_loaded) return;
+    unload_level(&s->board);
+    s->level_loaded = 0;
+}
+
+// Chamado pela thread do reactor com os bytes recebidos do cliente
+static void session_on_requests(reactor_handler_t* handler, const char* buf, ssize_t len) {
+    session_t* s = (session_t*)((char*)handler - offsetof(session_t, reader));
+
+    if (len == 0) {
+        debug("Cliente desconectado (Pipe fechado).\n");
+        __atomic_store_n(&s->client_gone, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    int discarded = 0;
+    int n_commands = parse_requests(&s->parser, &s->inputs, buf, len, &discarded);
+    if (n_commands < 0) {
+        __atomic_store_n(&s->client_gone, 1, __ATOMIC_RELEASE);
         return;
     }
+    if (n_commands > 0) metrics_count_commands(&s->stats, n_commands);
+    if (discarded > 0) metrics_count_discarded(discarded);
+}
+
+static void session_end(session_t* s) {
+    debug("Sessão de %s terminada.\n", s->board.player_id);
+
+    // Depois disto o reactor já não toca na sessão, nem aparecem novos espectadores
+    reactor_remove(&s->reader);
+    registry_remove(s);
+
+    // Recorde da sessão completa (e do nível a meio, se o jogo acabou nele)
+    int total = s->level_loaded ? s->board.pacmans[0].points : s->score_acumulado;
+    session_record_level(s);
+    score_store_record(s->board.player_id, SCORE_LEVEL_TOTAL, total);
+
+    // Sai da leaderboard e das métricas antes de libertar o slot, que pode ser logo reutilizado
+    leaderboard_remove(s->slot);
+    metrics_session_unregister(&s->stats);
+    if (s->on_end) s->on_end(s->slot);
+
+    // O cliente deixa de esperar por tabuleiros; o nome só existe se nunca chegou a abrir o segmento
+    if (s->shm) {
+        frame_shm_close(s->shm);
+        frame_shm_unmap(s->shm);
+        shm_unlink(s->shm_name);
+    }
+
+    session_unload_level(s);
+    free(s->encoder.frame);
+    free(s->encoder.last_frame);
+    free(s->encoder.delta_buf);
+    free(s->encoder.rle_buf);
+    free(s->notif_backlog.buf);
+    for (int i = 0; i < s->n_spectators; i++) close(s->spectators[i].fd);
+    pthread_mutex_destroy(&s->spectators_lock);
+    close(s->fd_notif);
+    close(s->fd_req);
+    free(s);
+}
 
-    // 2. Abrir pipes e Handshake
-    int fd_notif = open(notif_path, O_WRONLY);
-    int fd_req = open(req_path, O_RDONLY);
+// Envia o tabuleiro atual ao cliente e aos espectadores. Devolve -1 se o cliente desligou.
+static int session_broadcast(session_t* s, int victory) {
+    board_t* board = &s->board;
+
+    // Espectadores que já existiam antes deste tick; um que acabou de entrar força um keyframe
+    pthread_mutex_lock(&s->spectators_lock);
+    int n_spectators = s->n_spectators;
+    if (s->spectator_joined) s->encoder.frames_since_keyframe = 0;
+    s->spectator_joined = 0;
+    pthread_mutex_unlock(&s->spectators_lock);
+
+    viewport_follow(&s->encoder, board, 0);
+
+    frame_header_t sent;
+    const char* payload;
+    if (s->shm) {
+        publish_board_shm(s->shm, board, victory, &s->encoder, &s->stats, &sent, &payload);
+    } else if (send_board_frame(s->fd_notif, &s->notif_backlog, board, victory, &s->opts, &s->encoder,
+                                &s->stats, &sent, &payload) < 0) {
+        return -1;
+    }
+    if (n_spectators > 0) fan_out_frame(s, n_spectators, &sent, payload);
+    return 0;
+}
 
-    if (fd_notif < 0 || fd_req < 0) {
-        if (active_game_slot) *active_game_slot = NULL;
-        for (int i = 0; i < n_levels; i++) free(namelist[i]);
-        free(namelist);
+// Um tick da sessão, executado por um worker do scheduler
+static void session_run_tick(sched_task_t* task) {
+    session_t* s = (session_t*)task;
+    board_t* board = &s->board;
+    long long tick_start = current_time_ns();
+
+    if (__atomic_load_n(&s->client_gone, __ATOMIC_ACQUIRE)) {
+        session_end(s);
         return;
     }
 
-    char ack[2] = {(char)OP_CODE_CONNECT, 0};
-    write(fd_notif, ack, 2);
+    if (s->level_started) {
+        // Comandos que o reactor juntou desde o último tick
+        board_inputs_t inputs;
+        int discarded = input_queue_drain(&s->inputs, &inputs);
+        if (discarded > 0) metrics_count_discarded(discarded);
 
-    // --- 3. LOOP DE NÍVEIS ---
-    for (int i = 0; i < n_levels && session_running; i++) {
-        
-        debug("Nível %d: %s\n", i + 1, namelist[i]->d_name);
+        int x_antes = board->pacmans[0].pos_x;
+        int y_antes = board->pacmans[0].pos_y;
 
-        if (load_level(&board, namelist[i]->d_name, levels_dir, score_acumulado) < 0) {
-            break;
+        int result = board_step(board, &inputs);
+        session_publish_score(s);
+
+        if (inputs.n_moves > 0) {
+            debug("LOG MOVIMENTO: Teclas %.*s | Posição: (%d,%d) -> (%d,%d)\n",
+                inputs.n_moves, inputs.moves, x_antes, y_antes,
+                board->pacmans[0].pos_x, board->pacmans[0].pos_y);
         }
 
-        volatile int level_finished = 0;
-
-        // Lançar Threads
-        pthread_t pacman_tid;
-        pacman_task_args p_args = {fd_req, &board, &session_running, &level_finished};
-        pthread_create(&pacman_tid, NULL, server_pacman_task, &p_args);
-
-        pthread_t ghost_tids[MAX_GHOSTS];
-        for (int g = 0; g < board.n_ghosts; g++) {
-            ghost_task_args* g_args = malloc(sizeof(ghost_task_args));
-            g_args->board = &board;
-            g_args->ghost_index = g;
-            g_args->session_running = &session_running;
-            g_args->level_finished = &level_finished;
-            pthread_create(&ghost_tids[g], NULL, server_ghost_task, g_args);
+        if (result == REACHED_PORTAL && s->current_level + 1 >= s->n_levels) {
+            // Último nível: o cliente e os espectadores ainda recebem o tabuleiro final, com a vitória
+            debug("Portal do último nível atingido: vitória!\n");
+            session_broadcast(s, 1);
+            session_end(s);
+            return;
         }
 
-        // Game Loop
-        while (session_running && !level_finished) {
-            char op = (char)OP_CODE_BOARD;
-            write(fd_notif, &op, 1);
-            write(fd_notif, &board.width, sizeof(int));
-            write(fd_notif, &board.height, sizeof(int));
-            write(fd_notif, &board.tempo, sizeof(int));
-            
-            int victory = 0; 
-            int game_over = !board.pacmans[0].alive;
-            
-            write(fd_notif, &victory, sizeof(int));
-            write(fd_notif, &game_over, sizeof(int));
-            write(fd_notif, &board.pacmans[0].points, sizeof(int));
-
-            char* board_str = get_board_displayed(&board);
-            write(fd_notif, board_str, board.width * board.height);
-            free(board_str);
-
-            if (game_over) session_running = 0;
-
-            sleep_ms(board.tempo);
+        if (result == REACHED_PORTAL) {
+            debug("Portal atingido! A mudar de nível...\n");
+            session_record_level(s);
+            s->score_acumulado = board->pacmans[0].points;
+            session_unload_level(s);
+
+            s->current_level++;
+            if (session_load_level(s) < 0) {
+                session_end(s);
+                return;
+            }
         }
+    }
+
+    if (session_broadcast(s, 0) < 0) {
+        debug("Erro a enviar tabuleiro, cliente desligado.\n");
+        session_end(s);
+        return;
+    }
+
+    if (!board->pacmans[0].alive) {
+        session_end(s);
+        return;
+    }
+
+    // Primeiro tabuleiro de cada nível sai logo; os seguintes a cada tempo ms
+    if (!s->level_started) {
+        s->level_started = 1;
+        s->next_tick = current_time_ms();
+    }
+    s->next_tick += board->tempo;
+    metrics_observe_ns(METRIC_TICK_DURATION, current_time_ns() - tick_start);
+    scheduler_schedule(&s->task, s->next_tick);
+}
 
-        // Limpeza de Threads
-        pthread_cancel(pacman_tid); 
-        pthread_join(pacman_tid, NULL);
+// Liberta uma sessão que não chegou a completar o handshake (nada fora dela a conhece ainda)
+static void session_discard(session_t* s) {
+    frame_encoder_t* enc = &s->encoder;
+    if (s->fd_notif >= 0) close(s->fd_notif);
+    if (s->fd_req >= 0) close(s->fd_req);
+    if (s->shm) {
+        frame_shm_unmap(s->shm);
+        shm_unlink(s->shm_name);
+    }
+    free(enc->frame);
+    free(enc->last_frame);
+    free(enc->delta_buf);
+    free(enc->rle_buf);
+    free(s->notif_backlog.buf);
+    pthread_mutex_destroy(&s->spectators_lock);
+    free(s);
+}
 
-        for (int g = 0; g < board.n_ghosts; g++) {
-            pthread_join(ghost_tids[g], NULL);
+// Espera (sem bloquear o worker) que o cliente abra o pipe de notificações para leitura.
+// Corre no scheduler, para que um cliente que nunca abre os pipes não atrase as outras ligações.
+static void session_handshake(sched_task_t* task) {
+    session_t* s = (session_t*)task;
+    board_t* board = &s->board;
+
+    // Sem leitor do outro lado, um open não bloqueante para escrita falha com ENXIO
+    s->fd_notif = open(s->notif_path, O_WRONLY | O_NONBLOCK);
+    if (s->fd_notif < 0) {
+        if (errno == ENXIO && current_time_ms() < s->handshake_deadline) {
+            scheduler_schedule(&s->task, current_time_ms() + HANDSHAKE_RETRY_MS);
+            return;
         }
+        debug("Handshake falhou para %s: o cliente não abriu %s\n", board->player_id, s->notif_path);
+        int slot = s->slot;
+        void (*on_end)(int slot) = s->on_end;
+        session_discard(s);
+        if (on_end) on_end(slot);
+        return;
+    }
+
+    // Os dois pipes ficam não bloqueantes: o de pedidos só é lido pelo reactor e o de
+    // notificações é escrito com notif_send, para que nenhum worker espere por um cliente.
+    // Clientes OP_CODE_CONNECT_EXT recebem também as capacidades aceites (cabe sempre no pipe vazio)
+    char ack[CONNECT_EXT_RESPONSE_SIZE] = {(char)OP_CODE_CONNECT, 0, (char)s->opts.caps};
+    write(s->fd_notif, ack, s->opts.extended ? CONNECT_EXT_RESPONSE_SIZE : CONNECT_RESPONSE_SIZE);
+
+    s->stats.slot = s->slot;
+    strcpy(s->stats.player_id, board->player_id);
+    metrics_session_register(&s->stats);
+
+    // 3. Pedidos passam a chegar pelo reactor; o primeiro nível e os ticks pelo scheduler
+    s->reader.fd = s->fd_req;
+    s->reader.on_data = session_on_requests;
+    if (reactor_add(&s->reader) < 0) {
+        debug("Erro a registar o pipe de pedidos no reactor\n");
+        s->client_gone = 1; // termina no primeiro tick
+    }
 
-        if (session_running) score_acumulado = board.pacmans[0].points;
-        unload_level(&board);
-    } 
+    if (session_load_level(s) < 0) {
+        session_end(s);
+        return;
+    }
+
+    // Entra na leaderboard logo com os pontos iniciais; a partir daqui pode ter espectadores
+    session_publish_score(s);
+    registry_add(s);
+
+    s->task.run = session_run_tick;
+    scheduler_schedule(&s->task, current_time_ms());
+}
 
-    // Limpeza Final
-    if (active_game_slot) *active_game_slot = NULL;
+int start_session(char* req_path, char* notif_path, const session_options_t* opts,
+                  int slot, void (*on_end)(int slot)) {
+    session_t* s = calloc(1, sizeof(session_t));
+    if (s == NULL) return -1;
+
+    board_t* board = &s->board;
+    s->opts = *opts;
+    s->slot = slot;
+    s->published_points = -1;
+    s->fd_req = s->fd_notif = -1; // session_discard só fecha os que chegaram a abrir
+    pthread_mutex_init(&s->spectators_lock, NULL);
+    // Gerador próprio da sessão; o estado passa de nível para nível
+    board->rng_state = (unsigned int)(current_time_ns() ^ ((unsigned int)slot * 2654435761u));
     
-    for (int i = 0; i < n_levels; i++) free(namelist[i]);
-    free(namelist);
-    close(fd_notif);
-    close(fd_req);
-}
\ No newline at end of file
+    // Encontra a última barra '/' para ignorar a diretoria /tmp/
+    char *nome_base = strrchr(req_path, '/');
+    if (nome_base) {
+        nome_base++; // Avança a barra
+    } else {
+        nome_base = req_path;
+    }
+
+    // Copia até encontrar o underscore '_' de "_request"
+    char *underscore = strstr(nome_base, "_request");
+    if (underscore) {
+        size_t len = underscore - nome_base;
+        if (len >= sizeof(board->player_id)) len = sizeof(board->player_id) - 1;
+        strncpy(board->player_id, nome_base, len);
+        board->player_id[len] = '\0';
+    } else {
+        strcpy(board->player_id, "Unknown");
+    }
+
+    // 1. Níveis vêm da cache do servidor; os buffers de tabuleiro ficam logo com o tamanho máximo
+    s->n_levels = level_cache_count();
+    frame_encoder_t* enc = &s->encoder;
+    enc->capacity = level_cache_max_cells();
+    enc->frame = malloc(enc->capacity);
+
+    // Memória partilhada pedida: se não for possível criar o segmento, fica o pipe
+    s->opts.caps &= CLIENT_CAP_DELTA | CLIENT_CAP_SHM | CLIENT_CAP_VIEWPORT | CLIENT_CAP_RLE; // as restantes não são conhecidas
+    if (s->opts.extended && (s->opts.caps & CLIENT_CAP_SHM)) {
+        frame_shm_name(notif_path, s->shm_name);
+        s->shm = frame_shm_create(s->shm_name, enc->capacity);
+        if (s->shm == NULL) {
+            debug("Memória partilhada indisponível para %s, a usar o pipe\n", board->player_id);
+            s->opts.caps &= ~CLIENT_CAP_SHM;
+        }
+    } else {
+        s->opts.caps &= ~CLIENT_CAP_SHM;
+    }
+
+    // Último tabuleiro enviado ao cliente (base para os deltas, que só existem no pipe)
+    if ((s->opts.caps & CLIENT_CAP_DELTA) && s->shm == NULL) {
+        enc->last_frame = malloc(enc->capacity);
+        enc->delta_buf = malloc(enc->capacity);
+    } else {
+        s->opts.caps &= ~CLIENT_CAP_DELTA;
+    }
+
+    // Compressão só no pipe: na memória partilhada o tabuleiro é desenhado no próprio segmento
+    if ((s->opts.caps & CLIENT_CAP_RLE) && s->shm == NULL) {
+        enc->rle_buf = malloc(enc->capacity);
+    } else {
+        s->opts.caps &= ~CLIENT_CAP_RLE;
+    }
+
+    // Resto de um tabuleiro que o pipe de notificações não aceitou de uma vez
+    if (s->shm == NULL) s->notif_backlog.buf = malloc(sizeof(frame_header_t) + enc->capacity);
+
+    // Os ticks usam estes buffers sem verificar: sem memória a ligação falha já
+    if (enc->frame == NULL ||
+        ((s->opts.caps & CLIENT_CAP_DELTA) && (enc->last_frame == NULL || enc->delta_buf == NULL)) ||
+        ((s->opts.caps & CLIENT_CAP_RLE) && enc->rle_buf == NULL) ||
+        (s->shm == NULL && s->notif_backlog.buf == NULL)) {
+        debug("Sem memória para os buffers da sessão de %s\n", board->player_id);
+        session_discard(s);
+        return -1;
+    }
+
+    // 2. O pipe de pedidos abre já (para leitura, sem esperar pelo cliente); o de notificações
+    // e o resto do handshake ficam para o scheduler
+    s->fd_req = open(req_path, O_RDONLY | O_NONBLOCK);
+    if (s->fd_req < 0) {
+        session_discard(s);
+        return -1;
+    }
+
+    strncpy(s->notif_path, notif_path, sizeof(s->notif_path) - 1);
+    s->on_end = on_end;
+    s->handshake_deadline = current_time_ms() + HANDSHAKE_TIMEOUT_MS;
+    s->task.run = session_handshake;
+    scheduler_schedule(&s->task, current_time_ms());
+    return 0;
+}
+
@@ -0,0 +1,67 @@
+// Compilador offline de níveis: converte cada X.lvl de uma diretoria (e os seus .p/.m)
+// em X.lvlb na mesma diretoria, que o load_level passa a preferir ao texto.
+// Uso: levelc <diretoria_de_niveis>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "board.h"
+#include "parser.h"
+#include "level_binary.h"
+#include "debug.h"
+
+static int compile_level(char* dirname, char* filename) {
+    board_t board;
+    memset(&board, 0, sizeof(board));
+
+    // Lê sempre do texto, mesmo que já exista um .lvlb antigo
+    if (read_level(&board, filename, dirname) < 0) {
+        fprintf(stderr, "levelc: %s/%s: erro a ler o nível\n", dirname, filename);
+        return -1;
+    }
+    if (read_pacman(&board, 0) < 0 || read_ghosts(&board) < 0) {
+        fprintf(stderr, "levelc: %s/%s: erro a ler pacman ou fantasmas\n", dirname, filename);
+        unload_level(&board);
+        return -1;
+    }
+
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/%s%s", dirname, board.level_name, LEVELB_EXTENSION);
+    int result = write_level_binary(&board, path);
+    if (result < 0) {
+        fprintf(stderr, "levelc: %s: erro a escrever\n", path);
+    } else {
+        printf("%s (%d x %d, %d fantasmas)\n", path, board.width, board.height, board.n_ghosts);
+    }
+
+    unload_level(&board);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <levels_dir>\n", argv[0]);
+        return 1;
+    }
+
+    open_debug_file("/dev/null");
+
+    struct dirent **namelist;
+    int n_levels = scandir(argv[1], &namelist, filter_levels, alphasort);
+    if (n_levels < 0) {
+        perror("levelc: scandir");
+        close_debug_file();
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < n_levels; i++) {
+        if (compile_level(argv[1], namelist[i]->d_name) < 0) failed++;
+        free(namelist[i]);
+    }
+    free(namelist);
+    close_debug_file();
+
+    return failed ? 1 : 0;
+}
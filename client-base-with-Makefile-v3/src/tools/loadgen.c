@@ -0,0 +1,303 @@
+// Gerador de carga: lança N jogadores simulados (um processo por jogador, porque a api.c
+// só tem uma sessão por processo) que se ligam pelo FIFO de registo e repetem um script .p.
+// No fim mostra a latência de ligação, tabuleiros/s por cliente, a latência entre enviar
+// um comando e receber o primeiro tabuleiro em que o pacman já se moveu (cada cliente só envia
+// o comando seguinte depois disso; os que não o movem em LOADGEN_MATCH_FRAMES tabuleiros, por
+// exemplo contra uma parede, contam à parte), quantos clientes caíram e quantas alocações a api
+// fez depois do primeiro tabuleiro (0 em regime estável, fora mudanças de nível).
+// -m pede o transporte por memória partilhada em vez do pipe de notificações; -v LxA pede
+// só uma janela de L x A células à volta do pacman.
+// -r espaça o arranque dos clientes (por omissão ligam-se todos ao mesmo tempo).
+// Uso: loadgen [-n clientes] [-d segundos] [-r rampa_ms] [-p script.p] [-m] [-v LxA] <fifo_registo>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "api.h"
+#include "protocol.h"
+#include "debug.h"
+
+#define LOADGEN_MAX_SAMPLES 4096    // latências guardadas por cliente (cabem no buffer do pipe)
+#define LOADGEN_MAX_SCRIPT 4096
+#define LOADGEN_DEFAULT_SCRIPT "WDSA"
+#define LOADGEN_MATCH_FRAMES 16     // tabuleiros à espera do efeito de um comando antes de desistir
+
+// Resultado de um cliente, enviado ao pai pelo seu pipe e seguido de n_samples latências (us)
+typedef struct {
+    int connected;
+    int dropped;        // o servidor fechou a ligação antes do fim do teste
+    int game_over;
+    int shm;            // tabuleiros por memória partilhada
+    long long connect_ns;
+    long long frames;
+    long long elapsed_ns;
+    long long steady_allocs;    // alocações da api depois do primeiro tabuleiro
+    int unmatched;              // comandos que não moveram o pacman
+    int n_samples;
+} loadgen_result_t;
+
+// Só os comandos W/A/S/D, pela ordem do ficheiro (como o client_auto_move_thread)
+static int load_script(const char* path, char* script, int max) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    int n = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL && n < max - 1) {
+        if (line[0] == '#' || strncmp(line, "POS", 3) == 0 || strncmp(line, "PASSO", 5) == 0) continue;
+        for (int i = 0; line[i] != '\0' && n < max - 1; i++) {
+            char cmd = (char)toupper((unsigned char)line[i]);
+            if (cmd == 'W' || cmd == 'A' || cmd == 'S' || cmd == 'D') script[n++] = cmd;
+        }
+    }
+    script[n] = '\0';
+    fclose(fp);
+    return n;
+}
+
+static void write_all(int fd, const void* buf, size_t n) {
+    const char* p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0) return;
+        p += w;
+        n -= w;
+    }
+}
+
+static int read_all(int fd, void* buf, size_t n) {
+    char* p = buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return -1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+// Posição do pacman no nível (a janela pode ter-se movido), ou -1 se não está no tabuleiro
+static long long pacman_position(const Board* board) {
+    char* c = memchr(board->data, 'C', (size_t)board->width * board->height);
+    if (c == NULL) return -1;
+    int index = (int)(c - board->data);
+    return (long long)(board->view_y + index / board->width) * INT_MAX + board->view_x + index % board->width;
+}
+
+// Um jogador: envia um comando, espera pelo tabuleiro em que o pacman se moveu e envia o
+// seguinte, até ao fim do teste ou do jogo
+static void run_client(int index, const char* register_pipe, const char* script,
+                       long long duration_ns, int out_fd) {
+    char req_path[MAX_PIPE_PATH_LENGTH], notif_path[MAX_PIPE_PATH_LENGTH];
+    snprintf(req_path, MAX_PIPE_PATH_LENGTH, "/tmp/lg%d_%d_request", (int)getppid(), index);
+    snprintf(notif_path, MAX_PIPE_PATH_LENGTH, "/tmp/lg%d_%d_notification", (int)getppid(), index);
+
+    loadgen_result_t result;
+    memset(&result, 0, sizeof(result));
+    static int samples[LOADGEN_MAX_SAMPLES];
+
+    long long start = current_time_ns();
+    if (pacman_connect(req_path, notif_path, register_pipe) != 0) {
+        result.dropped = 1;
+        write_all(out_fd, &result, sizeof(result));
+        unlink(req_path);
+        unlink(notif_path);
+        return;
+    }
+    result.connected = 1;
+    result.shm = pacman_transport() == PACMAN_TRANSPORT_SHM;
+    result.connect_ns = current_time_ns() - start;
+
+    size_t script_len = strlen(script);
+    size_t next_cmd = 0;
+    long long sent_at = 0;      // 0: nenhum comando à espera de efeito
+    long long position_at_send = -1;
+    int frames_waiting = 0;
+    Board board = {0};
+    size_t capacity = 0;
+    unsigned long long allocs_at_first_frame = 0;
+    start = current_time_ns();
+
+    while (current_time_ns() - start < duration_ns) {
+        if (receive_board_update_into(&board, &capacity) < 0) {
+            result.dropped = 1;
+            break;
+        }
+        long long now = current_time_ns();
+        if (++result.frames == 1) allocs_at_first_frame = api_allocation_count();
+        long long position = pacman_position(&board);
+        if (sent_at > 0) {
+            if (position != position_at_send) {
+                if (result.n_samples < LOADGEN_MAX_SAMPLES) samples[result.n_samples++] = (int)((now - sent_at) / 1000);
+                sent_at = 0;
+            } else if (++frames_waiting >= LOADGEN_MATCH_FRAMES) {
+                result.unmatched++;
+                sent_at = 0;
+            }
+        }
+        if (board.game_over) {
+            result.game_over = 1;
+            break;
+        }
+
+        if (sent_at == 0) {
+            pacman_play(script[next_cmd++ % script_len]);
+            sent_at = current_time_ns();
+            position_at_send = position;
+            frames_waiting = 0;
+        }
+    }
+    result.elapsed_ns = current_time_ns() - start;
+    if (result.frames > 0) result.steady_allocs = api_allocation_count() - allocs_at_first_frame;
+    free(board.data);
+
+    if (!result.dropped) pacman_disconnect();
+    write_all(out_fd, &result, sizeof(result));
+    write_all(out_fd, samples, sizeof(int) * result.n_samples);
+
+    // O pacman_disconnect já os apaga; um cliente que caiu deixava-os em /tmp
+    unlink(req_path);
+    unlink(notif_path);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int percentile(const int* sorted, int n, double p) {
+    if (n == 0) return 0;
+    int i = (int)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void print_distribution(const char* name, int* values, int n) {
+    qsort(values, n, sizeof(int), compare_ints);
+    printf("%s: n=%d p50=%.3f p90=%.3f p99=%.3f max=%.3f ms\n", name, n,
+           percentile(values, n, 0.50) / 1000.0, percentile(values, n, 0.90) / 1000.0,
+           percentile(values, n, 0.99) / 1000.0, n ? values[n - 1] / 1000.0 : 0.0);
+}
+
+int main(int argc, char** argv) {
+    int n_clients = 10;
+    int duration_s = 10;
+    int ramp_ms = 0;
+    int use_shm = 0;
+    int view_width = 0, view_height = 0;
+    const char* script_file = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:r:p:mv:")) != -1) {
+        switch (opt) {
+            case 'n': n_clients = atoi(optarg); break;
+            case 'd': duration_s = atoi(optarg); break;
+            case 'r': ramp_ms = atoi(optarg); break;
+            case 'p': script_file = optarg; break;
+            case 'm': use_shm = 1; break;
+            case 'v':
+                if (sscanf(optarg, "%dx%d", &view_width, &view_height) != 2) view_width = view_height = 0;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n clients] [-d seconds] [-r ramp_ms] [-p script.p] [-m] [-v WxH] <register_pipe>\n", argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 1 || n_clients <= 0 || duration_s <= 0) {
+        fprintf(stderr, "Usage: %s [-n clients] [-d seconds] [-r ramp_ms] [-p script.p] [-m] [-v WxH] <register_pipe>\n", argv[0]);
+        return 1;
+    }
+    const char* register_pipe = argv[optind];
+
+    char script[LOADGEN_MAX_SCRIPT] = LOADGEN_DEFAULT_SCRIPT;
+    if (script_file && load_script(script_file, script, sizeof(script)) <= 0) {
+        fprintf(stderr, "loadgen: %s: sem comandos W/A/S/D\n", script_file);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if (use_shm) pacman_set_transport(PACMAN_TRANSPORT_SHM);
+    if (view_width > 0 && view_height > 0) pacman_set_viewport(view_width, view_height);
+    int* pipes = malloc(sizeof(int) * n_clients);
+    pid_t* pids = malloc(sizeof(pid_t) * n_clients);
+
+    for (int i = 0; i < n_clients; i++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("loadgen: pipe");
+            n_clients = i;
+            break;
+        }
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("loadgen: fork");
+            close(fds[0]);
+            close(fds[1]);
+            n_clients = i;
+            break;
+        }
+        if (pids[i] == 0) {
+            close(fds[0]);
+            open_debug_file("/dev/null");
+            run_client(i, register_pipe, script, duration_s * 1000000000LL, fds[1]);
+            close(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        pipes[i] = fds[0];
+        // Por omissão ligam-se todos de uma vez (o servidor lê vários pedidos por read);
+        // -r espaça as ligações para simular uma chegada gradual
+        if (ramp_ms > 0) sleep_ms(ramp_ms);
+    }
+
+    int* connect_us = malloc(sizeof(int) * n_clients);
+    int* latencies = malloc(sizeof(int) * (size_t)n_clients * LOADGEN_MAX_SAMPLES);
+    int n_connected = 0, n_dropped = 0, n_game_over = 0, n_latencies = 0, n_shm = 0, n_unmatched = 0;
+    double fps_sum = 0, fps_min = -1, fps_max = 0;
+    long long total_frames = 0;
+    long long steady_allocs = 0;
+
+    for (int i = 0; i < n_clients; i++) {
+        loadgen_result_t result;
+        if (read_all(pipes[i], &result, sizeof(result)) < 0) {
+            n_dropped++; // o processo morreu sem reportar
+        } else {
+            read_all(pipes[i], latencies + n_latencies, sizeof(int) * result.n_samples);
+            n_latencies += result.n_samples;
+            n_dropped += result.dropped;
+            n_game_over += result.game_over;
+            n_shm += result.shm;
+            n_unmatched += result.unmatched;
+            if (result.connected) {
+                connect_us[n_connected++] = (int)(result.connect_ns / 1000);
+                double fps = result.elapsed_ns > 0 ? result.frames * 1e9 / result.elapsed_ns : 0;
+                fps_sum += fps;
+                if (fps_min < 0 || fps < fps_min) fps_min = fps;
+                if (fps > fps_max) fps_max = fps;
+                total_frames += result.frames;
+                steady_allocs += result.steady_allocs;
+            }
+        }
+        close(pipes[i]);
+        waitpid(pids[i], NULL, 0);
+    }
+
+    printf("clients=%d connected=%d shm=%d dropped=%d game_over=%d frames=%lld\n",
+           n_clients, n_connected, n_shm, n_dropped, n_game_over, total_frames);
+    print_distribution("connect_latency", connect_us, n_connected);
+    printf("frames_per_sec: mean=%.2f min=%.2f max=%.2f\n",
+           n_connected ? fps_sum / n_connected : 0.0, fps_min < 0 ? 0.0 : fps_min, fps_max);
+    print_distribution("input_to_frame_latency", latencies, n_latencies);
+    printf("inputs_without_effect=%d\n", n_unmatched);
+    printf("client_allocs_after_first_frame=%lld\n", steady_allocs);
+
+    free(pipes);
+    free(pids);
+    free(connect_us);
+    free(latencies);
+    return n_dropped ? 2 : 0;
+}
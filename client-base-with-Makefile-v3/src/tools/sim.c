@@ -0,0 +1,150 @@
+// Simulação sem cliente nem relógio: corre os níveis de uma diretoria (pela ordem do servidor)
+// com os comandos de um script, um tick atrás do outro sem sleeps, e com o gerador aleatório
+// do tabuleiro semeado, pelo que a mesma seed e o mesmo script dão sempre o mesmo jogo.
+// O estado final vai para o stdout (comparável entre execuções); ticks/s vão para o stderr.
+// Script: formato dos .p; cada W/A/S/D é o comando de um tick e "T n" são n ticks sem comandos.
+// Uso: sim [-s seed] [-t max_ticks] <levels_dir> <script>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "board.h"
+#include "parser.h"
+#include "debug.h"
+
+#define SIM_DEFAULT_MAX_TICKS 100000
+#define SIM_MAX_SCRIPT 65536
+
+// Um carácter por tick: o comando, ou 0 para um tick sem comandos
+static int load_script(const char* path, char* ticks, int max) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    int n = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL && n < max) {
+        if (line[0] == '#' || strncmp(line, "POS", 3) == 0 || strncmp(line, "PASSO", 5) == 0) continue;
+        if (toupper((unsigned char)line[0]) == 'T' && line[1] == ' ') {
+            for (int t = atoi(line + 2); t > 0 && n < max; t--) ticks[n++] = 0;
+            continue;
+        }
+        // Como o client_auto_move_thread: todos os W/A/S/D da linha, por ordem
+        for (int i = 0; line[i] != '\0' && n < max; i++) {
+            char cmd = (char)toupper((unsigned char)line[i]);
+            if (cmd == 'W' || cmd == 'A' || cmd == 'S' || cmd == 'D') ticks[n++] = cmd;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+static void print_state(board_t* board, long long ticks, const char* result) {
+    char* frame = malloc(board->width * board->height);
+    render_board(board, frame);
+
+    printf("result=%s level=%s ticks=%lld points=%d pacman=(%d,%d)\n", result, board->level_name, ticks,
+           board->pacmans[0].points, board->pacmans[0].pos_x, board->pacmans[0].pos_y);
+    for (int y = 0; y < board->height; y++) {
+        printf("%.*s\n", board->width, frame + y * board->width);
+    }
+    free(frame);
+}
+
+int main(int argc, char** argv) {
+    unsigned int seed = 1;
+    long long max_ticks = SIM_DEFAULT_MAX_TICKS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:t:")) != -1) {
+        switch (opt) {
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 't': max_ticks = atoll(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-s seed] [-t max_ticks] <levels_dir> <script>\n", argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-s seed] [-t max_ticks] <levels_dir> <script>\n", argv[0]);
+        return 1;
+    }
+    char* levels_dir = argv[optind];
+
+    static char script[SIM_MAX_SCRIPT];
+    int script_len = load_script(argv[optind + 1], script, SIM_MAX_SCRIPT);
+    if (script_len < 0) {
+        perror("sim: script");
+        return 1;
+    }
+
+    struct dirent **namelist;
+    int n_levels = scandir(levels_dir, &namelist, filter_levels, alphasort);
+    if (n_levels <= 0) {
+        fprintf(stderr, "sim: nenhum nível em %s\n", levels_dir);
+        return 1;
+    }
+
+    open_debug_file("/dev/null");
+
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    board.rng_state = seed;
+
+    long long ticks = 0;
+    int level = 0;
+    int points = 0;
+    const char* result = "timeout";
+    long long start = current_time_ns();
+
+    if (load_level(&board, namelist[level]->d_name, levels_dir, points) < 0) {
+        fprintf(stderr, "sim: erro a carregar %s\n", namelist[level]->d_name);
+        return 1;
+    }
+
+    // O mesmo ciclo do tick do servidor, sem esperar pelo tempo do nível
+    while (ticks < max_ticks) {
+        board_inputs_t inputs = {0, {0}};
+        if (ticks < script_len && script[ticks]) {
+            inputs.moves[inputs.n_moves++] = script[ticks];
+        }
+
+        int step = board_step(&board, &inputs);
+        ticks++;
+
+        if (!board.pacmans[0].alive) {
+            result = "game_over";
+            break;
+        }
+        if (step == REACHED_PORTAL) {
+            if (level + 1 >= n_levels) {
+                result = "victory";
+                break;
+            }
+            // O gerador continua de um nível para o outro, como na sessão
+            points = board.pacmans[0].points;
+            unsigned int rng_state = board.rng_state;
+            unload_level(&board);
+            memset(&board, 0, sizeof(board));
+            board.rng_state = rng_state;
+            level++;
+            if (load_level(&board, namelist[level]->d_name, levels_dir, points) < 0) {
+                fprintf(stderr, "sim: erro a carregar %s\n", namelist[level]->d_name);
+                return 1;
+            }
+        }
+    }
+
+    long long elapsed = current_time_ns() - start;
+    print_state(&board, ticks, result);
+    fprintf(stderr, "ticks=%lld elapsed_ms=%.3f ticks_per_sec=%.0f\n", ticks, elapsed / 1e6,
+            elapsed > 0 ? ticks * 1e9 / elapsed : 0.0);
+
+    unload_level(&board);
+    for (int i = 0; i < n_levels; i++) free(namelist[i]);
+    free(namelist);
+    close_debug_file();
+    return 0;
+}